@@ -28,6 +28,7 @@
 #include <iostream>
 #include <chrono>
 #include <stdlib.h>
+#include <stdio.h>
 #include <algorithm>
 
 #include "sort.hpp"
@@ -47,6 +48,18 @@ struct timer {
     }
 };
 
+//Musser's median of 3 killer sequence, picking the median of the first, middle and last item gives the worst pivot at every step
+void median_of_3_killer(std::vector<uint32_t>& vec, size_t count) {
+	size_t half = count / 2;
+	vec.resize(count);
+	for(size_t i = 1; i <= half; ++i) {
+		vec[i - 1] = (i % 2 == 1) ? i : half + i - 1;
+		vec[half + i - 1] = 2 * i;
+	}
+	if(count % 2 == 1)
+		vec[count - 1] = count;
+}
+
 int main() {
 	//just pick a random seed
 	srand(time(NULL));
@@ -78,6 +91,30 @@ int main() {
 
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
+    {
+        std::cout << "test quick sort (dual pivot)" << std::endl;
+        //test quick sort (dual pivot)
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::quick_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_DUAL_PIVOT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
     {
         std::cout << "test stable quick sort" << std::endl;
         //test stable quick sort
@@ -174,6 +211,72 @@ int main() {
 
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
+    {
+        std::cout << "test hybrid merge sort (scratch arena)" << std::endl;
+        //test hybrid merge sort reusing the same scratch buffer
+        stlib::scratch_arena arena;
+        for(uint32_t j = 0; j < 2; ++j) {
+            std::vector<uint32_t> vec;
+            for(uint32_t i = 0; i < count; ++i)
+                vec.push_back(rand());
+
+            {
+                timer tmr;
+                stlib::hybrid_merge_sort(vec.begin(), vec.end(), arena);
+            }
+
+            std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+        }
+        std::cout << "huge pages : " << arena.huge_pages() << std::endl;
+    }
+    {
+        std::cout << "test radix sort" << std::endl;
+        //test radix sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::radix_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test american flag sort" << std::endl;
+        //test american flag sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::american_flag_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
     {
         std::cout << "test in-place merge sort" << std::endl;
         //test in-place merge sort
@@ -270,6 +373,54 @@ int main() {
 
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
+    {
+        std::cout << "test hybrid rotate merge sort (sym merge)" << std::endl;
+        //test hybrid rotate merge sort (sym merge)
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::hybrid_rotate_merge_sort(vec.begin(), vec.end(), stlib::NEW_ZIP_MERGE_KIND::NZMK_SYM_MERGE);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test hybrid rotate merge sort (binary merge)" << std::endl;
+        //test hybrid rotate merge sort (binary merge)
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::hybrid_rotate_merge_sort(vec.begin(), vec.end(), stlib::NEW_ZIP_MERGE_KIND::NZMK_BINARY_MERGE);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
     {
         std::cout << "test stackless rotate merge sort" << std::endl;
         //test rotate merge sort
@@ -294,6 +445,30 @@ int main() {
 
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
+    {
+        std::cout << "test stackless rotate merge sort (powersort)" << std::endl;
+        //test stackless rotate merge sort (powersort)
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::stackless_rotate_merge_sort(vec.begin(), vec.end(), stlib::STACKLESS_MERGE_KIND::SMK_POWERSORT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
     {
         std::cout << "test hybrid stackless rotate merge sort" << std::endl;
         //test rotate merge sort
@@ -318,6 +493,78 @@ int main() {
 
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
+    {
+        std::cout << "test hybrid stackless rotate merge sort (parity merge)" << std::endl;
+        //test hybrid stackless rotate merge sort (parity merge)
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::hybrid_stackless_rotate_merge_sort(vec.begin(), vec.end(), stlib::SMALL_SORT_KIND::SSK_PARITY_MERGE);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test block merge sort" << std::endl;
+        //test block merge sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::block_merge_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test hybrid block merge sort" << std::endl;
+        //test hybrid block merge sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::hybrid_block_merge_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
     {
         std::cout << "test zip sort" << std::endl;
         //test zip sort
@@ -559,15 +806,15 @@ int main() {
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
     {
-        std::cout << "test adaptive intro sort" << std::endl;
-        //test adaptive intro sort
+        std::cout << "test intro sort (dual pivot)" << std::endl;
+        //test intro sort (dual pivot)
         std::vector<uint32_t> vec;
         for(uint32_t i = 0; i < count; ++i)
             vec.push_back(rand());
 
         {
             timer tmr;
-            stlib::intro_sort(vec.begin(), vec.end());
+            stlib::intro_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_DUAL_PIVOT);
         }
 
 		if(verbose) {
@@ -583,15 +830,15 @@ int main() {
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
     {
-        std::cout << "test adaptive stable intro sort" << std::endl;
-        //test adaptive stable intro sort
+        std::cout << "test intro sort (parity merge)" << std::endl;
+        //test intro sort (parity merge)
         std::vector<uint32_t> vec;
         for(uint32_t i = 0; i < count; ++i)
             vec.push_back(rand());
 
         {
             timer tmr;
-            stlib::adaptive_stable_intro_sort(vec.begin(), vec.end());
+            stlib::intro_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_SINGLE_PIVOT, stlib::DEPTH_FALLBACK_KIND::DFK_MERGE_SORT, stlib::SMALL_SORT_KIND::SSK_PARITY_MERGE);
         }
 
 		if(verbose) {
@@ -607,15 +854,15 @@ int main() {
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
     {
-        std::cout << "test std::sort" << std::endl;
-        //test std::sort
+        std::cout << "test sample sort" << std::endl;
+        //test sample sort
         std::vector<uint32_t> vec;
         for(uint32_t i = 0; i < count; ++i)
             vec.push_back(rand());
 
         {
             timer tmr;
-            std::sort(&*vec.begin(), &*vec.end());
+            stlib::sample_sort(vec.begin(), vec.end());
         }
 
 		if(verbose) {
@@ -631,15 +878,691 @@ int main() {
         std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
     }
     {
-        std::cout << "test std::stable_sort" << std::endl;
-        //test std::stable_sort
+        std::cout << "test adaptive intro sort" << std::endl;
+        //test adaptive intro sort
         std::vector<uint32_t> vec;
         for(uint32_t i = 0; i < count; ++i)
             vec.push_back(rand());
 
         {
             timer tmr;
-            std::stable_sort(&*vec.begin(), &*vec.end());
+            stlib::intro_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test adaptive stable intro sort" << std::endl;
+        //test adaptive stable intro sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::adaptive_stable_intro_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test inplace stable quick sort" << std::endl;
+        //test inplace stable quick sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::inplace_stable_quick_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test std::sort" << std::endl;
+        //test std::sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            std::sort(&*vec.begin(), &*vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test std::stable_sort" << std::endl;
+        //test std::stable_sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            std::stable_sort(&*vec.begin(), &*vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test stable partial sort" << std::endl;
+        //test stable partial sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::stable_partial_sort(vec.begin(), vec.begin() + count / 100, vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.begin() + count / 100) << std::endl;
+    }
+    {
+        std::cout << "test nth element" << std::endl;
+        //test nth element
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::nth_element(vec.begin(), vec.begin() + count / 2, vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        bool partitioned = true;
+        for(uint32_t i = 0; i < count; ++i)
+            if(i < count / 2 ? vec[i] > vec[count / 2] : vec[i] < vec[count / 2])
+                partitioned = false;
+        std::cout << "sorted : " << partitioned << std::endl;
+    }
+    {
+        std::cout << "test stable nth element" << std::endl;
+        //test stable nth element
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::stable_nth_element(vec.begin(), vec.begin() + count / 2, vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        bool partitioned = true;
+        for(uint32_t i = 0; i < count; ++i)
+            if(i < count / 2 ? vec[i] > vec[count / 2] : vec[i] < vec[count / 2])
+                partitioned = false;
+        std::cout << "sorted : " << partitioned << std::endl;
+    }
+    {
+        std::cout << "test argsort" << std::endl;
+        //test argsort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<uint32_t> idx(count);
+
+        {
+            timer tmr;
+            stlib::argsort(vec.begin(), vec.end(), idx.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        bool sorted = true;
+        for(uint32_t i = 1; i < count; ++i)
+            if(vec[idx[i - 1]] > vec[idx[i]])
+                sorted = false;
+        std::cout << "sorted : " << sorted << std::endl;
+    }
+    {
+        std::cout << "test stable argsort" << std::endl;
+        //test stable argsort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<uint32_t> idx(count);
+
+        {
+            timer tmr;
+            stlib::stable_argsort(vec.begin(), vec.end(), idx.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        bool sorted = true;
+        for(uint32_t i = 1; i < count; ++i)
+            if(vec[idx[i - 1]] > vec[idx[i]])
+                sorted = false;
+        std::cout << "sorted : " << sorted << std::endl;
+    }
+    {
+        std::cout << "test apply permutation" << std::endl;
+        //test apply permutation
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<uint32_t> idx(count);
+
+        {
+            timer tmr;
+            stlib::stable_argsort(vec.begin(), vec.end(), idx.begin());
+            stlib::apply_permutation(vec.begin(), vec.end(), idx.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test apply permutation parallel" << std::endl;
+        //test apply permutation parallel
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<uint32_t> idx(count);
+
+        {
+            timer tmr;
+            stlib::stable_argsort(vec.begin(), vec.end(), idx.begin());
+            stlib::apply_permutation_parallel(vec.begin(), vec.end(), idx.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test sort by key" << std::endl;
+        //test sort by key
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<uint32_t> vals = vec;
+
+        {
+            timer tmr;
+            stlib::stable_sort_by_key(vec.begin(), vec.end(), vals.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << (stlib::is_sorted(vec.begin(), vec.end()) && vals == vec) << std::endl;
+    }
+    {
+        std::cout << "test sort by" << std::endl;
+        //test sort by
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        {
+            timer tmr;
+            stlib::stable_sort_by(vec.begin(), vec.end(), [](uint32_t val) { return val; });
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test sorted vector" << std::endl;
+        //test sorted vector
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        stlib::sorted_vector<uint32_t> sorted;
+
+        {
+            timer tmr;
+            for(uint32_t i = 0; i < count; i += 100)
+                sorted.insert(vec.begin() + i, vec.begin() + std::min<size_t>(i + 100, count));
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << sorted[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << (stlib::is_sorted(sorted.begin(), sorted.end()) && sorted.size() == count) << std::endl;
+    }
+    {
+        std::cout << "test kway merge" << std::endl;
+        //test kway merge
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<std::pair<std::vector<uint32_t>::iterator, std::vector<uint32_t>::iterator>> runs;
+        for(uint32_t i = 0; i < count; i += 100) {
+            stlib::hybrid_merge_sort(vec.begin() + i, vec.begin() + std::min<size_t>(i + 100, count));
+            runs.push_back(std::make_pair(vec.begin() + i, vec.begin() + std::min<size_t>(i + 100, count)));
+        }
+        std::vector<uint32_t> sorted(count);
+
+        {
+            timer tmr;
+            stlib::kway_merge(runs, sorted.begin());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << sorted[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(sorted.begin(), sorted.end()) << std::endl;
+    }
+    {
+        std::cout << "test kway merge inplace" << std::endl;
+        //test kway merge inplace
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        std::vector<std::vector<uint32_t>::iterator> bounds;
+        for(uint32_t i = 0; i < count; i += 100) {
+            stlib::hybrid_merge_sort(vec.begin() + i, vec.begin() + std::min<size_t>(i + 100, count));
+            bounds.push_back(vec.begin() + i);
+        }
+        bounds.push_back(vec.end());
+
+        {
+            timer tmr;
+            stlib::kway_merge_inplace(bounds);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test external sort" << std::endl;
+        //test external sort
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+
+        bool ok = false;
+        {
+            timer tmr;
+            FILE* fl = fopen("external_sort_in.bin", "wb");
+            if(fl) {
+                ok = fwrite(vec.data(), sizeof(uint32_t), count, fl) == count;
+                if(fclose(fl) != 0)
+                    ok = false;
+            }
+            //a small budget so that there are several runs to merge
+            ok = ok && stlib::external_sort("external_sort_in.bin", "external_sort_out.bin", sizeof(uint32_t), 0, sizeof(uint32_t), 1024,
+                                            stlib::EXTERNAL_SORT_KEY_KIND::ESKK_LITTLE_ENDIAN_UNSIGNED);
+            if(ok) {
+                fl = fopen("external_sort_out.bin", "rb");
+                ok = fl && fread(vec.data(), sizeof(uint32_t), count, fl) == count;
+                if(fl)
+                    fclose(fl);
+            }
+            if(!ok)
+                std::cout << "external sort failed" << std::endl;
+            remove("external_sort_in.bin");
+            remove("external_sort_out.bin");
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << (ok && stlib::is_sorted(vec.begin(), vec.end())) << std::endl;
+    }
+    {
+        std::cout << "test sort stream" << std::endl;
+        //test sort stream
+        std::vector<uint32_t> vec;
+        for(uint32_t i = 0; i < count; ++i)
+            vec.push_back(rand());
+        stlib::sort_stream<uint32_t> stream;
+
+        {
+            timer tmr;
+            for(uint32_t i = 0; i < count; i += 100)
+                stream.push(vec.begin() + i, vec.begin() + std::min<size_t>(i + 100, count));
+            stream.finish();
+            vec.assign(stream.begin(), stream.end());
+        }
+        //pushing after finish is refused
+        bool refused = !stream.push(vec.begin(), vec.begin() + 1);
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << (stlib::is_sorted(vec.begin(), vec.end()) && vec.size() == count && refused && stream.size() == count) << std::endl;
+    }
+
+    {
+        std::cout << "test sort stream (shrinking chunks)" << std::endl;
+        //test sort stream (shrinking chunks)
+        //chunks of 200, 199, ... 1 items, none of which carries on from the last, the runs must still stay O(log n)
+        std::vector<uint32_t> vec;
+        stlib::sort_stream<uint32_t> stream;
+        size_t most_runs = 0;
+        size_t limit = 0;
+
+        {
+            timer tmr;
+            for(uint32_t chunk = 200; chunk > 0; --chunk) {
+                std::vector<uint32_t> items;
+                for(uint32_t i = 0; i < chunk; ++i)
+                    items.push_back(rand());
+                vec.insert(vec.end(), items.begin(), items.end());
+                stream.push(items.begin(), items.end());
+                most_runs = std::max(most_runs, stream.runs());
+            }
+            //the run lengths grow atleast as fast as the fibonacci numbers
+            for(size_t fib1 = 1, fib2 = 1; fib2 <= vec.size(); ++limit) {
+                size_t fib3 = fib1 + fib2;
+                fib1 = fib2;
+                fib2 = fib3;
+            }
+            stream.finish();
+            vec.assign(stream.begin(), stream.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < vec.size(); ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << (stlib::is_sorted(vec.begin(), vec.end()) && vec.size() == 20100 && most_runs <= limit + 1) << std::endl;
+    }
+
+	//median of 3 killer sequences, these drive quick sort to the depth limit so time the fallback sorts
+    {
+        std::cout << "test intro sort (median of 3 killer, heap sort fallback)" << std::endl;
+        //test intro sort (median of 3 killer, heap sort fallback)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::intro_quick_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_SINGLE_PIVOT, stlib::DEPTH_FALLBACK_KIND::DFK_HEAP_SORT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test intro sort (median of 3 killer, merge sort fallback)" << std::endl;
+        //test intro sort (median of 3 killer, merge sort fallback)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::intro_quick_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_SINGLE_PIVOT, stlib::DEPTH_FALLBACK_KIND::DFK_MERGE_SORT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test intro sort (median of 3 killer, hybrid stackless rotate merge sort fallback)" << std::endl;
+        //test intro sort (median of 3 killer, hybrid stackless rotate merge sort fallback)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::intro_quick_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_SINGLE_PIVOT, stlib::DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test intro sort (median of 3 killer, rotate merge sort fallback)" << std::endl;
+        //test intro sort (median of 3 killer, rotate merge sort fallback)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::intro_quick_sort(vec.begin(), vec.end(), stlib::PARTITION_KIND::PK_SINGLE_PIVOT, stlib::DEPTH_FALLBACK_KIND::DFK_ROTATE_MERGE_SORT);
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test adaptive intro sort (median of 3 killer)" << std::endl;
+        //test adaptive intro sort (median of 3 killer)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::intro_sort(vec.begin(), vec.end());
+        }
+
+		if(verbose) {
+			std::cout << "[" << std::endl;
+			for(uint32_t i = 0; i < count; ++i) {
+				std::cout << "[ " << vec[i] << "], ";
+				if(i > 0 && i % 5 == 0)
+					std::cout << std::endl;
+			}
+			std::cout << "]" << std::endl;
+		}
+
+        std::cout << "sorted : " << stlib::is_sorted(vec.begin(), vec.end()) << std::endl;
+    }
+    {
+        std::cout << "test adaptive stable intro sort (median of 3 killer)" << std::endl;
+        //test adaptive stable intro sort (median of 3 killer)
+        std::vector<uint32_t> vec;
+        median_of_3_killer(vec, count);
+
+        {
+            timer tmr;
+            stlib::adaptive_stable_intro_sort(vec.begin(), vec.end());
         }
 
 		if(verbose) {
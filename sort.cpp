@@ -26,6 +26,21 @@
 
 #include "sort.hpp"
 
+#include <stdio.h>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
 namespace stlib {
 namespace stlib_internal {
 
@@ -37,6 +52,126 @@ void aligned_storage_delete(size_t sze, void* ptr) {
 	delete[] (double*)ptr;
 }
 
+#if defined(__linux__)
+size_t read_huge_page_size() {
+	//default huge page size on x86-64 and most arm64 kernels
+	size_t sze = 2 * 1024 * 1024;
+	FILE* fl = fopen("/proc/meminfo", "r");
+	if(fl) {
+		char line[256];
+		while(fgets(line, sizeof(line), fl)) {
+			unsigned long kb = 0;
+			if(sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+				if(kb > 0)
+					sze = kb * 1024;
+				break;
+			}
+		}
+		fclose(fl);
+	}
+	return sze;
+}
+size_t huge_page_size() {
+	static const size_t sze = read_huge_page_size();
+	return sze;
+}
+bool mapping_has_huge_pages(void* ptr) {
+	//find the mapping holding ptr in /proc/self/smaps, and see if any of it is backed by transparent huge pages
+	FILE* fl = fopen("/proc/self/smaps", "r");
+	if(!fl)
+		return false;
+	uintptr_t addr = (uintptr_t)ptr;
+	bool in_mapping = false;
+	bool found = false;
+	char line[512];
+	while(fgets(line, sizeof(line), fl)) {
+		unsigned long beg = 0;
+		unsigned long end = 0;
+		//the first line of each mapping is its address range
+		if(sscanf(line, "%lx-%lx ", &beg, &end) == 2) {
+			if(in_mapping)
+				break;
+			in_mapping = beg <= addr && addr < end;
+			continue;
+		}
+		unsigned long kb = 0;
+		if(in_mapping && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+			found = kb > 0;
+			break;
+		}
+	}
+	fclose(fl);
+	return found;
+}
+void* scratch_arena_map(scratch_arena& arena, size_t sze) {
+	size_t page = huge_page_size();
+	size_t len = (sze + page - 1) / page * page;
+#ifdef MAP_HUGETLB
+	//first try explicit huge pages, only works if the huge page pool has been reserved (vm.nr_hugepages)
+	void* ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(ptr != MAP_FAILED) {
+		arena.ptr = ptr;
+		arena.capacity = len;
+		arena.page_kind = SCRATCH_PAGE_KIND::SPK_HUGE_PAGES;
+		arena.mapped = true;
+		return ptr;
+	}
+#endif
+	//otherwise map normal pages, over allocate by one huge page so that we can align the buffer to the huge page size
+	//(transparent huge pages are only used for huge page aligned ranges)
+	void* raw = mmap(nullptr, len + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(raw == MAP_FAILED)
+		return nullptr;
+	uintptr_t addr = (uintptr_t)raw;
+	uintptr_t aligned = (addr + page - 1) / page * page;
+	//give back the unused head and tail
+	if(aligned != addr)
+		munmap(raw, aligned - addr);
+	if(addr + len + page != aligned + len)
+		munmap((void*)(aligned + len), (addr + len + page) - (aligned + len));
+
+	arena.ptr = (void*)aligned;
+	arena.capacity = len;
+	arena.page_kind = SCRATCH_PAGE_KIND::SPK_NORMAL_PAGES;
+	arena.mapped = true;
+#ifdef MADV_HUGEPAGE
+	//madvise succeeds even if the kernel won't give huge pages (THP set to never, or none free), so fault the first page
+	//in and check what backs it
+	if(madvise(arena.ptr, len, MADV_HUGEPAGE) == 0) {
+		*(volatile char*)arena.ptr = 0;
+		if(mapping_has_huge_pages(arena.ptr))
+			arena.page_kind = SCRATCH_PAGE_KIND::SPK_TRANSPARENT_HUGE_PAGES;
+		else
+			arena.page_kind = SCRATCH_PAGE_KIND::SPK_TRANSPARENT_HUGE_PAGES_REQUESTED;
+	}
+#endif
+	return arena.ptr;
+}
+#endif
+void* scratch_arena_acquire(scratch_arena& arena, size_t sze) {
+	//reuse the existing buffer if it is big enough
+	if(arena.ptr && arena.capacity >= sze)
+		return arena.ptr;
+	arena.release();
+
+#if defined(__linux__)
+	//only worth it for buffers of atleast one huge page
+	if(arena.use_huge_pages && sze >= huge_page_size()) {
+		void* ptr = scratch_arena_map(arena, sze);
+		if(ptr)
+			return ptr;
+	}
+#endif
+	//fallback to normal allocation
+	arena.ptr = aligned_storage_new(sze);
+	if(arena.ptr) {
+		arena.capacity = sze;
+		arena.page_kind = SCRATCH_PAGE_KIND::SPK_NORMAL_PAGES;
+		arena.mapped = false;
+	}
+	return arena.ptr;
+}
+
 bool equal_func_bool(const bool less, const bool greater) {
 	return !less && !greater;
 }
@@ -67,6 +202,34 @@ bool start_out_of_place_merge(uint64_t sze, uint64_t insert_count) {
 	return count % 2 == 1;
 }
 
+unsigned powersort_node_power(uint64_t beg1, uint64_t len1, uint64_t len2, uint64_t sze) {
+	//the midpoints of the two runs (scaled by 2 to keep this in integers)
+	//the power is the first bit at which a / (2 * sze) and b / (2 * sze) differ
+	uint64_t a = 2 * beg1 + len1;
+	uint64_t b = a + len1 + len2;
+	unsigned power = 0;
+	for(;;) {
+		++power;
+		if(a >= sze) {
+			a -= sze;
+			b -= sze;
+		} else if(b >= sze)
+			break;
+		a <<= 1;
+		b <<= 1;
+	}
+	return power;
+}
+
+uint64_t hwang_lin_step(uint64_t longer, uint64_t shorter) {
+	//the largest power of two no more than longer / shorter
+	uint64_t ratio = longer / shorter;
+	uint64_t step = 1;
+	while(step * 2 <= ratio)
+		step *= 2;
+	return step;
+}
+
 zip_merge_indexes& get_current_indexes(zip_merge_indexes* indexes, unsigned indexes_end) {
 	if(indexes_end == 0)
 		return indexes[NEW_ZIP_SORT_INDEX_ARRAY_SIZE - 1];
@@ -107,5 +270,443 @@ bool indexes_full(unsigned indexes_start, unsigned indexes_end) {
 	return NEW_ZIP_SORT_INDEX_ARRAY_SIZE - calculate_index_total(indexes_start, indexes_end) <= 1;
 }
 
+struct external_sort_layout {
+	size_t record_size;
+	size_t key_offset;
+	size_t key_width;
+	EXTERNAL_SORT_KEY_KIND kind;
+
+	uint64_t prefix(const char* rec) const {
+		//the key (or the first 8 bytes of it) as a number, so that most compares are of numbers
+		const unsigned char* key = (const unsigned char*)rec + key_offset;
+		uint64_t out = 0;
+		if(kind == EXTERNAL_SORT_KEY_KIND::ESKK_LITTLE_ENDIAN_UNSIGNED) {
+			for(size_t i = key_width; i > 0; --i)
+				out = (out << 8) | key[i - 1];
+			return out;
+		}
+		//read as big endian, then shorter keys are moved to the top so they sort the same as memcmp
+		size_t len = key_width < 8 ? key_width : 8;
+		for(size_t i = 0; i < len; ++i)
+			out = (out << 8) | key[i];
+		return len == 8 ? out : out << (8 * (8 - len));
+	}
+	int compare_rest(const char* lhs, const char* rhs) const {
+		//compare records with the same prefix, only byte keys longer than 8 can still differ
+		if(kind != EXTERNAL_SORT_KEY_KIND::ESKK_BYTES || key_width <= 8)
+			return 0;
+		return memcmp(lhs + key_offset + 8, rhs + key_offset + 8, key_width - 8);
+	}
+};
+
+int64_t external_file_size(FILE* fl) {
+	//the size of the file in bytes, or -1 if it can't be found
+#if defined(_WIN32)
+	if(_fseeki64(fl, 0, SEEK_END) != 0)
+		return -1;
+	int64_t sze = _ftelli64(fl);
+	if(_fseeki64(fl, 0, SEEK_SET) != 0)
+		return -1;
+#else
+	if(fseeko(fl, 0, SEEK_END) != 0)
+		return -1;
+	int64_t sze = ftello(fl);
+	if(fseeko(fl, 0, SEEK_SET) != 0)
+		return -1;
+#endif
+	return sze;
+}
+
+struct external_run {
+	//only open while the run is written or merged, so there are never more files open than runs merged at once
+	FILE* fl = nullptr;
+	std::string path;
+	uint64_t records = 0;
+};
+std::string external_temp_prefix(const char* out_path, const char* temp_dir) {
+	//temporary files go in temp_dir, or next to the output (tmpfile() would often put them in memory)
+	if(temp_dir != nullptr)
+		return std::string(temp_dir) + "/";
+	std::string out(out_path);
+#if defined(_WIN32)
+	size_t sep = out.find_last_of("/\\");
+#else
+	size_t sep = out.find_last_of('/');
+#endif
+	return sep == std::string::npos ? std::string() : out.substr(0, sep + 1);
+}
+bool external_open_run(external_run& run, const std::string& prefix) {
+	//the name is made unique by creating the file, so sorts running at the same time can't take each other's files
+	std::string name = prefix + "stlib_external_sort_XXXXXX";
+#if defined(_WIN32)
+	if(_mktemp_s(&name[0], name.size() + 1) != 0)
+		return false;
+	int fd = -1;
+	if(_sopen_s(&fd, name.c_str(), _O_CREAT | _O_EXCL | _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+		return false;
+	run.fl = _fdopen(fd, "w+b");
+	if(!run.fl) {
+		_close(fd);
+		remove(name.c_str());
+		return false;
+	}
+#else
+	int fd = mkstemp(&name[0]);
+	if(fd < 0)
+		return false;
+	run.fl = fdopen(fd, "w+b");
+	if(!run.fl) {
+		close(fd);
+		remove(name.c_str());
+		return false;
+	}
+#endif
+	run.path = name;
+	return true;
+}
+bool external_finish_run(external_run& run) {
+	//close the run once written, it is opened again by path when it is merged
+	bool ok = fclose(run.fl) == 0;
+	run.fl = nullptr;
+	return ok;
+}
+void external_close_run(external_run& run) {
+	if(run.fl)
+		fclose(run.fl);
+	if(!run.path.empty())
+		remove(run.path.c_str());
+	run.fl = nullptr;
+	run.path.clear();
+}
+
+struct external_run_reader {
+	//reads a run a block at a time, the next block is read on another thread while this one is merged
+	FILE* fl = nullptr;
+	size_t record_size = 0;
+	size_t block_records = 0;
+	//records in the file not read yet
+	uint64_t unread = 0;
+	std::vector<char> front;
+	std::vector<char> back;
+	size_t front_count = 0;
+	size_t back_count = 0;
+	size_t pos = 0;
+	std::thread pending;
+	bool failed = false;
+
+	~external_run_reader() {
+		if(pending.joinable())
+			pending.join();
+		if(fl)
+			fclose(fl);
+	}
+	void start_read() {
+		size_t count = unread < block_records ? (size_t)unread : block_records;
+		unread -= count;
+		pending = std::thread([this, count]() {
+			back_count = fread(back.data(), record_size, count, fl);
+			if(back_count != count)
+				failed = true;
+		});
+	}
+	void next_block() {
+		pending.join();
+		front.swap(back);
+		front_count = back_count;
+		pos = 0;
+		if(unread > 0)
+			start_read();
+	}
+	bool open(const std::string& path, uint64_t records, size_t rsize, size_t block) {
+		fl = fopen(path.c_str(), "rb");
+		if(!fl)
+			return false;
+		record_size = rsize;
+		block_records = block;
+		unread = records;
+		front.resize(block * rsize);
+		back.resize(block * rsize);
+		start_read();
+		next_block();
+		return true;
+	}
+	bool empty() const {
+		return pos == front_count;
+	}
+	const char* head() const {
+		return front.data() + pos * record_size;
+	}
+	void pop() {
+		++pos;
+		if(pos == front_count && pending.joinable())
+			next_block();
+	}
+};
+struct external_run_writer {
+	//writes a block at a time, each block is written on another thread while the next one is filled
+	FILE* fl = nullptr;
+	size_t record_size = 0;
+	size_t block_records = 0;
+	std::vector<char> front;
+	std::vector<char> back;
+	size_t count = 0;
+	std::thread pending;
+	bool failed = false;
+
+	~external_run_writer() {
+		if(pending.joinable())
+			pending.join();
+	}
+	void open(FILE* file, size_t rsize, size_t block) {
+		fl = file;
+		record_size = rsize;
+		block_records = block;
+		front.resize(block * rsize);
+		back.resize(block * rsize);
+	}
+	void flush() {
+		if(pending.joinable())
+			pending.join();
+		front.swap(back);
+		size_t items = count;
+		count = 0;
+		pending = std::thread([this, items]() {
+			if(fwrite(back.data(), record_size, items, fl) != items)
+				failed = true;
+		});
+	}
+	void push(const char* rec) {
+		memcpy(front.data() + count * record_size, rec, record_size);
+		if(++count == block_records)
+			flush();
+	}
+	bool finish() {
+		if(count > 0)
+			flush();
+		if(pending.joinable())
+			pending.join();
+		return !failed && fflush(fl) == 0;
+	}
+};
+
+bool external_merge_runs(std::vector<external_run>& runs, size_t first, size_t last, FILE* out,
+						 const external_sort_layout& layout, size_t block_records) {
+	//merge runs [first, last) into out with a loser tree (as kway_merge), equal keys are won by the earlier run so this is stable
+	unsigned k = (unsigned)(last - first);
+	std::vector<external_run_reader> readers(k);
+	for(unsigned i = 0; i < k; ++i)
+		if(!readers[i].open(runs[first + i].path, runs[first + i].records, layout.record_size, block_records))
+			return false;
+	external_run_writer writer;
+	writer.open(out, layout.record_size, block_records);
+
+	auto beats = [&](unsigned lhs, unsigned rhs) {
+		if(readers[rhs].empty())
+			return !readers[lhs].empty() || lhs < rhs;
+		if(readers[lhs].empty())
+			return false;
+		uint64_t lprefix = layout.prefix(readers[lhs].head());
+		uint64_t rprefix = layout.prefix(readers[rhs].head());
+		if(lprefix != rprefix)
+			return lprefix < rprefix;
+		int rest = layout.compare_rest(readers[lhs].head(), readers[rhs].head());
+		if(rest != 0)
+			return rest < 0;
+		return lhs < rhs;
+	};
+	std::vector<unsigned> tree(k);
+	std::vector<unsigned> winner(2 * k);
+	for(unsigned i = 0; i < k; ++i)
+		winner[k + i] = i;
+	for(unsigned node = k - 1; node > 0; --node) {
+		unsigned lhs = winner[2 * node];
+		unsigned rhs = winner[2 * node + 1];
+		if(beats(lhs, rhs)) {
+			winner[node] = lhs;
+			tree[node] = rhs;
+		} else {
+			winner[node] = rhs;
+			tree[node] = lhs;
+		}
+	}
+	tree[0] = winner[1];
+
+	for(;;) {
+		unsigned win = tree[0];
+		if(readers[win].empty())
+			break;
+		writer.push(readers[win].head());
+		readers[win].pop();
+		for(unsigned node = (win + k) / 2; node > 0; node /= 2)
+			if(beats(tree[node], win))
+				std::swap(tree[node], win);
+		tree[0] = win;
+	}
+
+	bool ok = writer.finish();
+	for(auto& rdr : readers)
+		ok = ok && !rdr.failed;
+	return ok;
+}
+bool external_write_sorted(FILE* out, const char* data, const std::vector<keyed_index<uint64_t, uint64_t>>& entries, size_t record_size) {
+	for(const auto& ent : entries)
+		if(fwrite(data + ent.idx * record_size, record_size, 1, out) != 1)
+			return false;
+	return fflush(out) == 0;
+}
+
+}
+
+scratch_arena::~scratch_arena() {
+	release();
+}
+void scratch_arena::release() {
+	if(ptr == nullptr)
+		return;
+#if defined(__linux__)
+	if(mapped)
+		munmap(ptr, capacity);
+	else
+		stlib_internal::aligned_storage_delete(capacity, ptr);
+#else
+	stlib_internal::aligned_storage_delete(capacity, ptr);
+#endif
+	ptr = nullptr;
+	capacity = 0;
+	page_kind = SCRATCH_PAGE_KIND::SPK_NONE;
+	mapped = false;
+}
+
+bool external_sort(const char* in_path, const char* out_path, size_t record_size, size_t key_offset, size_t key_width,
+				   size_t memory_budget, EXTERNAL_SORT_KEY_KIND kind, const char* temp_dir) {
+	if(record_size == 0 || key_width == 0 || key_offset + key_width > record_size)
+		return false;
+	if(kind == EXTERNAL_SORT_KEY_KIND::ESKK_LITTLE_ENDIAN_UNSIGNED && key_width > 8)
+		return false;
+	stlib_internal::external_sort_layout layout = {record_size, key_offset, key_width, kind};
+	using entry = stlib_internal::keyed_index<uint64_t, uint64_t>;
+
+	FILE* in = fopen(in_path, "rb");
+	if(!in)
+		return false;
+	int64_t file_size = stlib_internal::external_file_size(in);
+	if(file_size < 0 || file_size % record_size != 0) {
+		fclose(in);
+		return false;
+	}
+	uint64_t total = file_size / record_size;
+
+	//each record in memory needs its bytes and an entry (key prefix and position) to sort
+	uint64_t chunk_records = memory_budget / (record_size + sizeof(entry));
+	if(chunk_records == 0)
+		chunk_records = 1;
+	if(chunk_records > total)
+		chunk_records = total;
+
+	std::vector<stlib_internal::external_run> runs;
+	std::string prefix = stlib_internal::external_temp_prefix(out_path, temp_dir);
+	bool ok = true;
+	auto cleanup = [&]() {
+		for(auto& run : runs)
+			stlib_internal::external_close_run(run);
+	};
+
+	//sort each chunk and write it out as a run, if it all fits in one chunk it goes straight to the output
+	{
+		std::vector<char> data(chunk_records * record_size);
+		std::vector<entry> entries;
+		entries.reserve(chunk_records);
+		uint64_t remaining = total;
+		do {
+			uint64_t count = remaining < chunk_records ? remaining : chunk_records;
+			remaining -= count;
+			if(count > 0 && fread(data.data(), record_size, count, in) != count) {
+				ok = false;
+				break;
+			}
+			entries.clear();
+			for(uint64_t i = 0; i < count; ++i)
+				entries.push_back({layout.prefix(data.data() + i * record_size), i});
+			//the records aren't a type that can be moved about, so the entries are sorted, without needing any more memory
+			const char* base = data.data();
+			hybrid_stackless_rotate_merge_sort(entries.begin(), entries.end(), [&layout, base, record_size](const entry& lhs, const entry& rhs) {
+				if(lhs.key != rhs.key)
+					return lhs.key < rhs.key;
+				return layout.compare_rest(base + lhs.idx * record_size, base + rhs.idx * record_size) < 0;
+			});
+
+			if(remaining == 0 && runs.empty()) {
+				FILE* out = fopen(out_path, "wb");
+				ok = out && stlib_internal::external_write_sorted(out, base, entries, record_size);
+				if(out && fclose(out) != 0)
+					ok = false;
+				fclose(in);
+				return ok;
+			}
+			stlib_internal::external_run run;
+			if(!stlib_internal::external_open_run(run, prefix)) {
+				ok = false;
+				break;
+			}
+			run.records = count;
+			runs.push_back(run);
+			if(!stlib_internal::external_write_sorted(runs.back().fl, base, entries, record_size) || !stlib_internal::external_finish_run(runs.back())) {
+				ok = false;
+				break;
+			}
+		} while(remaining > 0);
+	}
+	fclose(in);
+	if(!ok) {
+		cleanup();
+		return false;
+	}
+
+	//a read block and a read ahead block for each run and the same for the output, if the blocks would be too small
+	//with every run merged at once merge them in groups first
+	size_t fan_in = (size_t)(memory_budget / (2 * EXTERNAL_SORT_MIN_BLOCK_BYTES));
+	fan_in = fan_in > 3 ? fan_in - 1 : 2;
+	if(fan_in > EXTERNAL_SORT_MAX_FAN_IN)
+		fan_in = EXTERNAL_SORT_MAX_FAN_IN;
+	while(runs.size() > fan_in) {
+		std::vector<stlib_internal::external_run> next;
+		for(size_t first = 0; first < runs.size() && ok; first += fan_in) {
+			size_t last = first + fan_in < runs.size() ? first + fan_in : runs.size();
+			stlib_internal::external_run run;
+			if(!stlib_internal::external_open_run(run, prefix)) {
+				ok = false;
+				break;
+			}
+			for(size_t i = first; i < last; ++i)
+				run.records += runs[i].records;
+			next.push_back(run);
+			size_t block = (size_t)(memory_budget / (2 * (last - first + 1)) / record_size);
+			ok = stlib_internal::external_merge_runs(runs, first, last, next.back().fl, layout, block > 0 ? block : 1);
+			if(!stlib_internal::external_finish_run(next.back()))
+				ok = false;
+			for(size_t i = first; i < last; ++i)
+				stlib_internal::external_close_run(runs[i]);
+		}
+		if(!ok) {
+			for(auto& run : next)
+				stlib_internal::external_close_run(run);
+			cleanup();
+			return false;
+		}
+		runs.swap(next);
+	}
+
+	FILE* out = fopen(out_path, "wb");
+	if(!out) {
+		cleanup();
+		return false;
+	}
+	size_t block = (size_t)(memory_budget / (2 * (runs.size() + 1)) / record_size);
+	ok = stlib_internal::external_merge_runs(runs, 0, runs.size(), out, layout, block > 0 ? block : 1);
+	if(fclose(out) != 0)
+		ok = false;
+	cleanup();
+	return ok;
 }
+
 }
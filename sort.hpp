@@ -28,26 +28,146 @@
 #include <utility>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include <vector>
 #include <algorithm>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+#include <thread>
+#include <atomic>
 
 namespace stlib {
 
 constexpr int INSERTION_SORT_CUTOFF = 32;
+//how many items in a row one side of a merge has to win before merge_internal starts galloping (adapts as the merge goes)
+constexpr unsigned MERGE_MIN_GALLOP = 7;
+//buckets of this many items or fewer in american_flag_sort are finished with multi_insertion_sort
+constexpr int AMERICAN_FLAG_SORT_CUTOFF = 64;
+//stlib::sort uses american_flag_sort for integer and floating point lists of atleast this many items, otherwise intro_sort
+constexpr int SORT_RADIX_CUTOFF = 1024;
+//intro_sort, nearly sorted partitions are finished with an insertion sort unless it needs to move more than this many items
+constexpr int PARTIAL_INSERTION_SORT_LIMIT = 8;
+//intro_sort, items compared at a time in block partition, the offsets are stored as unsigned char so this must be no more than 255
+constexpr int BLOCK_PARTITION_SIZE = 64;
+//sample_sort, splits into 1 << SAMPLE_SORT_BUCKET_BITS buckets, the bucket of each item is stored as a uint8_t so this must be no more than 8
+constexpr unsigned SAMPLE_SORT_BUCKET_BITS = 8;
+//sample_sort, samples taken for each bucket, the splitters are every SAMPLE_SORT_OVERSAMPLE'th of the sorted samples
+constexpr unsigned SAMPLE_SORT_OVERSAMPLE = 16;
+//sample_sort, lists with fewer items than this are sorted directly on the calling thread
+constexpr uint64_t SAMPLE_SORT_CUTOFF = 1 << 16;
+//inplace_stable_quick_sort, bytes of stack used to stable partition, longer partitions are split in half and the halves rotated together
+constexpr size_t STABLE_PARTITION_BUFFER_BYTES = 2048;
+//stable_partial_sort, when more than 1 / STABLE_PARTIAL_SORT_FULL_SORT_RATIO of the list is kept the whole list is sorted
+constexpr uint64_t STABLE_PARTIAL_SORT_FULL_SORT_RATIO = 16;
+//kway_merge_inplace, bytes of buffer used to merge neighbouring runs, merges of runs both larger than this are split up with rotations
+constexpr size_t KWAY_MERGE_BUFFER_BYTES = 1 << 20;
+//external_sort, smallest block read from each run at a time when merging, if there are more runs than fit in the memory budget they are merged in several passes
+constexpr size_t EXTERNAL_SORT_MIN_BLOCK_BYTES = 1 << 20;
+//external_sort, most runs merged at once, each holds a file open while it is merged
+constexpr size_t EXTERNAL_SORT_MAX_FAN_IN = 32;
 
 constexpr int NEW_ZIP_SORT_ARRAY_SIZE = 64;
 constexpr int NEW_ZIP_SORT_INDEX_ARRAY_SIZE = 7000;
 
+//copies of trivially copyable items in contiguous memory below this many bytes are done one item at a time, above it use memcpy
+#if defined(_MSC_VER) && !defined(__clang__)
+//MSVC, moving one at a time was found to be faster then memcpy, so never use it
+constexpr size_t BULK_MOVE_CUTOFF = SIZE_MAX;
+#else
+//GCC/Clang (glibc), memcpy is faster from 32 bytes (8 uint32_t) up, the loop is 2x slower at 64 bytes and 10x slower at 512 bytes
+constexpr size_t BULK_MOVE_CUTOFF = 32;
+#endif
+
 //general distance function for pointers
 template<typename U>
 inline ptrdiff_t distance(U* first, U* last) {
 	return last - first;
 }
 
+enum class SCRATCH_PAGE_KIND : uint8_t {
+	//nothing has been allocated yet
+	SPK_NONE,
+	//normal pages, huge pages were either not requested or not available
+	SPK_NORMAL_PAGES,
+	//transparent huge pages requested with madvise, but the kernel didn't back the buffer with them (THP off or none free)
+	SPK_TRANSPARENT_HUGE_PAGES_REQUESTED,
+	//transparent huge pages requested with madvise, and the kernel backed the buffer with them (checked in /proc/self/smaps)
+	SPK_TRANSPARENT_HUGE_PAGES,
+	//explicit huge pages taken from the huge page pool (MAP_HUGETLB)
+	SPK_HUGE_PAGES
+};
+
+//reusable scratch memory for the buffered sorts (merge_sort, hybrid_merge_sort)
+//keep one of these alive between calls to avoid allocating (and page faulting) a new buffer every sort
+//on linux this will try to get huge pages for the buffer, this cuts down on TLB misses for large sorts
+//not thread safe, use one per thread
+struct scratch_arena {
+	void* ptr = nullptr;
+	size_t capacity = 0;
+	SCRATCH_PAGE_KIND page_kind = SCRATCH_PAGE_KIND::SPK_NONE;
+	//set to false to only ever use normal pages
+	bool use_huge_pages = true;
+	//memory came from mmap rather than aligned_storage_new
+	bool mapped = false;
+
+	scratch_arena() = default;
+	explicit scratch_arena(bool huge_pages) : use_huge_pages(huge_pages) {}
+	scratch_arena(const scratch_arena&) = delete;
+	scratch_arena& operator=(const scratch_arena&) = delete;
+	~scratch_arena();
+
+	//did the last allocation get huge pages, only true if they are known to back the buffer
+	bool huge_pages() const {
+		return page_kind == SCRATCH_PAGE_KIND::SPK_HUGE_PAGES || page_kind == SCRATCH_PAGE_KIND::SPK_TRANSPARENT_HUGE_PAGES;
+	}
+	//give the memory back to the system
+	void release();
+};
+
+enum class NEW_ZIP_MERGE_KIND : uint8_t {
+	NZMK_RECURSIVE,
+	//possibly slightly faster than above
+	NZMK_ROTATE_MERGE,
+	//slower than both of the above options, gives constant memory usage
+	NZMK_INPLACE_MERGE,
+	//calls older zip_merge, gives constant memory usage
+	NZMK_ZIP_MERGE,
+	//SymMerge (Kim and Kutzner), constant memory, O(m log(n/m + 1)) comparisons merging m items with n
+	NZMK_SYM_MERGE,
+	//Hwang-Lin binary merge done with rotations, constant memory, O(m log(n/m + 1)) comparisons, best when one side is tiny
+	NZMK_BINARY_MERGE
+};
+
+enum class SMALL_SORT_KIND : uint8_t {
+	//multi_insertion_sort, few moves, fastest on nearly sorted blocks and items that are expensive to move
+	SSK_MULTI_INSERTION_SORT,
+	//quadsort style branchless parity merges through a buffer on the stack, faster on random blocks of cheap to compare items
+	SSK_PARITY_MERGE
+};
+
+enum class EXTERNAL_SORT_KEY_KIND : uint8_t {
+	//the key bytes are compared in order (as memcmp), for strings and big endian unsigned integers
+	ESKK_BYTES,
+	//the key is a little endian unsigned integer of upto 8 bytes
+	ESKK_LITTLE_ENDIAN_UNSIGNED
+};
+
+template<typename Itr>
+void rotate_merge_sort(Itr beg, Itr end, NEW_ZIP_MERGE_KIND kind = NEW_ZIP_MERGE_KIND::NZMK_ROTATE_MERGE);
+template<typename Itr, typename Comp>
+void rotate_merge_sort(Itr beg, Itr end, Comp cmp, NEW_ZIP_MERGE_KIND kind = NEW_ZIP_MERGE_KIND::NZMK_ROTATE_MERGE);
 template<typename Itr>
-void rotate_merge_sort(Itr beg, Itr end);
+void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end, SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
 template<typename Itr, typename Comp>
-void rotate_merge_sort(Itr beg, Itr end, Comp cmp);
+void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end, Comp cmp, SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+template<typename Itr>
+bool hybrid_merge_sort(Itr beg, Itr end);
+template<typename Itr, typename Comp>
+bool hybrid_merge_sort(Itr beg, Itr end, Comp cmp);
+template<typename Itr>
+inline void sort(Itr beg, Itr end);
 
 namespace stlib_internal {
 
@@ -57,6 +177,7 @@ template<typename Itr, typename IdxItr, typename Comp>
 void stable_rotate_merge_sort(Itr strt, Itr beg, Itr end, IdxItr begidx, Comp cmp);
 template<typename Itr, typename IdxItr>
 void stable_quick_sort_swap(Itr beg, Itr left, Itr right, IdxItr begidx);
+uint64_t hwang_lin_step(uint64_t longer, uint64_t shorter);
 
 template<typename T>
 struct value_for {
@@ -136,6 +257,8 @@ bool greater_equal_func_bool(const bool less);
 
 void* aligned_storage_new(size_t sze);
 void aligned_storage_delete(size_t sze, void* ptr);
+//get atleast sze bytes from the arena, reuses the existing memory if it is large enough
+void* scratch_arena_acquire(scratch_arena& arena, size_t sze);
 
 template<typename Itr>
 void rotate(Itr first, Itr middle, Itr last) {
@@ -169,12 +292,44 @@ void reverse(Itr first, Itr last) {
 		++first;
 	}
 }
+//can the range be treated as raw memory (pointers and std::vector iterators)
+template<typename Itr>
+struct is_contiguous_iterator {
+	using valueof = typename std::remove_cv<typename value_for<Itr>::value_type>::type;
+	static constexpr bool value = !std::is_same<valueof, bool>::value &&
+								  (std::is_pointer<Itr>::value ||
+								   std::is_same<Itr, typename std::vector<valueof>::iterator>::value);
+};
+//can we move from one range to the other with memcpy
 template<typename Itr1, typename Itr2>
-void copy_buffers(Itr1 beg, Itr1 end, Itr2& out) {
-	//found to be faster then memcpy!!!
+struct use_bulk_move {
+	using valueof1 = typename std::remove_cv<typename value_for<Itr1>::value_type>::type;
+	using valueof2 = typename std::remove_cv<typename value_for<Itr2>::value_type>::type;
+	static constexpr bool value = std::is_same<valueof1, valueof2>::value &&
+								  std::is_trivially_copyable<valueof1>::value &&
+								  is_contiguous_iterator<Itr1>::value &&
+								  is_contiguous_iterator<Itr2>::value;
+};
+template<typename Itr1, typename Itr2>
+void copy_buffers(Itr1 beg, Itr1 end, Itr2& out, std::false_type) {
 	for(; beg != end; ++beg, ++out)
 		construct(*out, std::move(*beg));
 }
+template<typename Itr1, typename Itr2>
+void copy_buffers(Itr1 beg, Itr1 end, Itr2& out, std::true_type) {
+	using valueof = typename value_for<Itr1>::value_type;
+	ptrdiff_t sze = distance(beg, end);
+	if(sze <= 0 || (size_t)sze * sizeof(valueof) < BULK_MOVE_CUTOFF) {
+		copy_buffers(beg, end, out, std::false_type());
+		return;
+	}
+	memcpy((void*)&*out, (const void*)&*beg, sze * sizeof(valueof));
+	out += sze;
+}
+template<typename Itr1, typename Itr2>
+void copy_buffers(Itr1 beg, Itr1 end, Itr2& out) {
+	copy_buffers(beg, end, out, std::integral_constant<bool, use_bulk_move<Itr1, Itr2>::value>());
+}
 
 
 template<typename Itr, typename IdxItr>
@@ -389,6 +544,185 @@ bool is_reverse_sorted(Itr beg, Itr end, Comp cmp) {
 }
 
 
+enum class DEPTH_FALLBACK_KIND : uint8_t {
+	//heap_sort, in-place with O(n log n) moves (the stable sorts heap sort on item and index together)
+	DFK_HEAP_SORT,
+	//hybrid_merge_sort, needs a buffer the size of the partition, hybrid_stackless_rotate_merge_sort is used if that can't be allocated
+	DFK_MERGE_SORT,
+	//hybrid_stackless_rotate_merge_sort, in-place and constant stack but O(n log^2 n) moves
+	DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT,
+	//rotate_merge_sort, the original fallback
+	DFK_ROTATE_MERGE_SORT
+};
+namespace stlib_internal {
+template<typename Itr>
+void sift_down(Itr beg, uint64_t root, uint64_t sze) {
+	using valueof = typename value_for<Itr>::value_type;
+	//move the root down until both children are no larger
+	valueof tmp = std::move(*(beg + root));
+	for(;;) {
+		uint64_t child = 2 * root + 1;
+		if(child >= sze)
+			break;
+		if(child + 1 < sze && less_func(*(beg + child), *(beg + (child + 1))))
+			++child;
+		if(!less_func(tmp, *(beg + child)))
+			break;
+		*(beg + root) = std::move(*(beg + child));
+		root = child;
+	}
+	*(beg + root) = std::move(tmp);
+}
+template<typename Itr, typename Comp>
+void sift_down(Itr beg, uint64_t root, uint64_t sze, Comp cmp) {
+	using valueof = typename value_for<Itr>::value_type;
+	//move the root down until both children are no larger
+	valueof tmp = std::move(*(beg + root));
+	for(;;) {
+		uint64_t child = 2 * root + 1;
+		if(child >= sze)
+			break;
+		if(child + 1 < sze && less_func(*(beg + child), *(beg + (child + 1)), cmp))
+			++child;
+		if(!less_func(tmp, *(beg + child), cmp))
+			break;
+		*(beg + root) = std::move(*(beg + child));
+		root = child;
+	}
+	*(beg + root) = std::move(tmp);
+}
+template<typename Itr, typename IdxItr>
+void stable_sift_down(Itr beg, Itr first, uint64_t root, uint64_t sze, IdxItr begidx) {
+	//as above, but ordered by item and then index, the item and index are swapped together
+	for(;;) {
+		uint64_t child = 2 * root + 1;
+		if(child >= sze)
+			return;
+		if(child + 1 < sze && stable_quick_sort_less_func(beg, first + child, first + (child + 1), begidx))
+			++child;
+		if(!stable_quick_sort_less_func(beg, first + root, first + child, begidx))
+			return;
+		stable_quick_sort_swap(beg, first + root, first + child, begidx);
+		root = child;
+	}
+}
+template<typename Itr, typename IdxItr, typename Comp>
+void stable_sift_down(Itr beg, Itr first, uint64_t root, uint64_t sze, IdxItr begidx, Comp cmp) {
+	//as above, but ordered by item and then index, the item and index are swapped together
+	for(;;) {
+		uint64_t child = 2 * root + 1;
+		if(child >= sze)
+			return;
+		if(child + 1 < sze && stable_quick_sort_less_func(beg, first + child, first + (child + 1), begidx, cmp))
+			++child;
+		if(!stable_quick_sort_less_func(beg, first + root, first + child, begidx, cmp))
+			return;
+		stable_quick_sort_swap(beg, first + root, first + child, begidx);
+		root = child;
+	}
+}
+template<typename Itr, typename IdxItr>
+void stable_merge_sort_fallback(Itr beg, Itr first, Itr last, IdxItr begidx) {
+	//sort the items paired with their indexes in a buffer, ordered by item and then index
+	using valueof = typename value_for<Itr>::value_type;
+	using idxof = typename value_for<IdxItr>::value_type;
+	IdxItr bidx = begidx + distance(beg, first);
+	std::vector<std::pair<valueof, idxof>> buf;
+	buf.reserve(distance(first, last));
+	for(Itr it = first; it != last; ++it)
+		buf.push_back(std::make_pair(std::move(*it), *(bidx + distance(first, it))));
+	bool sorted = hybrid_merge_sort(buf.begin(), buf.end(), [](const std::pair<valueof, idxof>& lhs, const std::pair<valueof, idxof>& rhs) {
+		if(less_func(lhs.first, rhs.first))
+			return true;
+		return !less_func(rhs.first, lhs.first) && lhs.second < rhs.second;
+	});
+
+	for(Itr it = first; it != last; ++it) {
+		*it = std::move(buf[distance(first, it)].first);
+		*(bidx + distance(first, it)) = buf[distance(first, it)].second;
+	}
+	//no memory for the merge, do it in-place
+	if(!sorted)
+		stable_rotate_merge_sort(beg, first, last, begidx);
+}
+template<typename Itr, typename IdxItr, typename Comp>
+void stable_merge_sort_fallback(Itr beg, Itr first, Itr last, IdxItr begidx, Comp cmp) {
+	//sort the items paired with their indexes in a buffer, ordered by item and then index
+	using valueof = typename value_for<Itr>::value_type;
+	using idxof = typename value_for<IdxItr>::value_type;
+	IdxItr bidx = begidx + distance(beg, first);
+	std::vector<std::pair<valueof, idxof>> buf;
+	buf.reserve(distance(first, last));
+	for(Itr it = first; it != last; ++it)
+		buf.push_back(std::make_pair(std::move(*it), *(bidx + distance(first, it))));
+	bool sorted = hybrid_merge_sort(buf.begin(), buf.end(), [cmp](const std::pair<valueof, idxof>& lhs, const std::pair<valueof, idxof>& rhs) {
+		if(less_func(lhs.first, rhs.first, cmp))
+			return true;
+		return !less_func(rhs.first, lhs.first, cmp) && lhs.second < rhs.second;
+	});
+
+	for(Itr it = first; it != last; ++it) {
+		*it = std::move(buf[distance(first, it)].first);
+		*(bidx + distance(first, it)) = buf[distance(first, it)].second;
+	}
+	//no memory for the merge, do it in-place
+	if(!sorted)
+		stable_rotate_merge_sort(beg, first, last, begidx, cmp);
+}
+template<typename Itr, typename IdxItr>
+void stable_heap_sort(Itr beg, Itr first, Itr last, IdxItr begidx) {
+	//no two items have the same index, so this gives the same order as a stable sort
+	uint64_t sze = distance(first, last);
+	if(sze <= 1)
+		return;
+	for(uint64_t i = sze / 2; i > 0; --i)
+		stable_sift_down(beg, first, i - 1, sze, begidx);
+	for(uint64_t i = sze - 1; i > 0; --i) {
+		stable_quick_sort_swap(beg, first, first + i, begidx);
+		stable_sift_down(beg, first, 0, i, begidx);
+	}
+}
+template<typename Itr, typename IdxItr, typename Comp>
+void stable_heap_sort(Itr beg, Itr first, Itr last, IdxItr begidx, Comp cmp) {
+	//no two items have the same index, so this gives the same order as a stable sort
+	uint64_t sze = distance(first, last);
+	if(sze <= 1)
+		return;
+	for(uint64_t i = sze / 2; i > 0; --i)
+		stable_sift_down(beg, first, i - 1, sze, begidx, cmp);
+	for(uint64_t i = sze - 1; i > 0; --i) {
+		stable_quick_sort_swap(beg, first, first + i, begidx);
+		stable_sift_down(beg, first, 0, i, begidx, cmp);
+	}
+}
+}
+template<typename Itr>
+void heap_sort(Itr beg, Itr end) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+	//build a max heap, then keep moving the largest item to the end
+	for(uint64_t i = sze / 2; i > 0; --i)
+		stlib_internal::sift_down(beg, i - 1, sze);
+	for(uint64_t i = sze - 1; i > 0; --i) {
+		std::swap(*beg, *(beg + i));
+		stlib_internal::sift_down(beg, 0, i);
+	}
+}
+template<typename Itr, typename Comp>
+void heap_sort(Itr beg, Itr end, Comp cmp) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+	//build a max heap, then keep moving the largest item to the end
+	for(uint64_t i = sze / 2; i > 0; --i)
+		stlib_internal::sift_down(beg, i - 1, sze, cmp);
+	for(uint64_t i = sze - 1; i > 0; --i) {
+		std::swap(*beg, *(beg + i));
+		stlib_internal::sift_down(beg, 0, i, cmp);
+	}
+}
+
 namespace stlib_internal {
 template<typename Itr>
 struct stack_less_data {
@@ -414,10 +748,24 @@ struct intro_stack_less_data {
 };
 template<typename Itr>
 void add_stack_item(Itr beg1, Itr end1, Itr beg2, Itr end2, unsigned depth,
-					std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx) {
+					std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, DEPTH_FALLBACK_KIND fallback) {
 	if(depth == 1) {
-		//do O(n log n) rotate merge if we have reached the maximum depth
-		rotate_merge_sort(beg1, end1);
+		//do an O(n log n) sort if we have reached the maximum depth
+		switch(fallback) {
+		case DEPTH_FALLBACK_KIND::DFK_HEAP_SORT:
+			heap_sort(beg1, end1);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_MERGE_SORT:
+			if(!hybrid_merge_sort(beg1, end1))
+				hybrid_stackless_rotate_merge_sort(beg1, end1);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT:
+			hybrid_stackless_rotate_merge_sort(beg1, end1);
+			break;
+		default:
+			rotate_merge_sort(beg1, end1);
+			break;
+		}
 	} else {
 		intro_stack_less_data<Itr> dat = {
 			beg2,
@@ -431,10 +779,24 @@ void add_stack_item(Itr beg1, Itr end1, Itr beg2, Itr end2, unsigned depth,
 }
 template<typename Itr, typename Comp>
 void add_stack_item(Itr beg1, Itr end1, Itr beg2, Itr end2, unsigned depth,
-					std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, Comp cmp) {
+					std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, Comp cmp, DEPTH_FALLBACK_KIND fallback) {
 	if(depth == 1) {
-		//do O(n log n) rotate merge if we have reached the maximum depth
-		rotate_merge_sort(beg1, end1, cmp);
+		//do an O(n log n) sort if we have reached the maximum depth
+		switch(fallback) {
+		case DEPTH_FALLBACK_KIND::DFK_HEAP_SORT:
+			heap_sort(beg1, end1, cmp);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_MERGE_SORT:
+			if(!hybrid_merge_sort(beg1, end1, cmp))
+				hybrid_stackless_rotate_merge_sort(beg1, end1, cmp);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT:
+			hybrid_stackless_rotate_merge_sort(beg1, end1, cmp);
+			break;
+		default:
+			rotate_merge_sort(beg1, end1, cmp);
+			break;
+		}
 	} else {
 		intro_stack_less_data<Itr> dat = {
 			beg2,
@@ -448,10 +810,21 @@ void add_stack_item(Itr beg1, Itr end1, Itr beg2, Itr end2, unsigned depth,
 }
 template<typename Itr, typename IdxItr>
 void stable_add_stack_item(Itr beg, Itr beg1, Itr end1, Itr beg2, Itr end2, IdxItr begidx, unsigned depth,
-						   std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx) {
+						   std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, DEPTH_FALLBACK_KIND fallback) {
 	if(depth == 1) {
-		//do O(n log n) inplace rotate merge sort if we have reached the maximum depth
-		stable_rotate_merge_sort(beg, beg1, end1, begidx);
+		//do an O(n log n) sort if we have reached the maximum depth, the indexes have to move with the items
+		//so the in-place merge sorts both use the stable rotate merge sort
+		switch(fallback) {
+		case DEPTH_FALLBACK_KIND::DFK_HEAP_SORT:
+			stable_heap_sort(beg, beg1, end1, begidx);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_MERGE_SORT:
+			stable_merge_sort_fallback(beg, beg1, end1, begidx);
+			break;
+		default:
+			stable_rotate_merge_sort(beg, beg1, end1, begidx);
+			break;
+		}
 	} else {
 		intro_stack_less_data<Itr> dat = {
 			beg2,
@@ -465,10 +838,21 @@ void stable_add_stack_item(Itr beg, Itr beg1, Itr end1, Itr beg2, Itr end2, IdxI
 }
 template<typename Itr, typename IdxItr, typename Comp>
 void stable_add_stack_item(Itr beg, Itr beg1, Itr end1, Itr beg2, Itr end2, IdxItr begidx, unsigned depth,
-						   std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, Comp cmp) {
+						   std::vector<intro_stack_less_data<Itr>>& stk, size_t& idx, Comp cmp, DEPTH_FALLBACK_KIND fallback) {
 	if(depth == 1) {
-		//do O(n log n) inplace rotate merge sort if we have reached the maximum depth
-		stable_rotate_merge_sort(beg, beg1, end1, begidx, cmp);
+		//do an O(n log n) sort if we have reached the maximum depth, the indexes have to move with the items
+		//so the in-place merge sorts both use the stable rotate merge sort
+		switch(fallback) {
+		case DEPTH_FALLBACK_KIND::DFK_HEAP_SORT:
+			stable_heap_sort(beg, beg1, end1, begidx, cmp);
+			break;
+		case DEPTH_FALLBACK_KIND::DFK_MERGE_SORT:
+			stable_merge_sort_fallback(beg, beg1, end1, begidx, cmp);
+			break;
+		default:
+			stable_rotate_merge_sort(beg, beg1, end1, begidx, cmp);
+			break;
+		}
 	} else {
 		intro_stack_less_data<Itr> dat = {
 			beg2,
@@ -790,7 +1174,87 @@ bool binary_search(Itr beg, Itr end, const T& item,
 	}
 	return out != end && stlib_internal::greater_equal_func(*out, item, comp) && stlib_internal::less_equal_func(*out, item, comp);
 }
+template<typename Itr, typename T>
+bool exponential_search(Itr beg, Itr end, const T& item,
+						Itr& out) {
+	//exponential (galloping) search, same result as binary_search but the cost grows with the distance of the insertion point from beg
+	//rather than with the size of the list, so is much quicker when the item belongs near the start
+	ptrdiff_t sze = distance(beg, end);
+	ptrdiff_t lst = 0;
+	ptrdiff_t ofs = 1;
+	//gallop forward 1, 3, 7, 15... items until we find one that is not less than the item
+	while(ofs <= sze && stlib_internal::less_func(*(beg + (ofs - 1)), item)) {
+		lst = ofs;
+		ofs = ofs * 2 + 1;
+	}
+	//the insertion point is now between lst and ofs, binary search only this range
+	ptrdiff_t lim = (ofs < sze ? ofs : sze);
+	return binary_search(beg + lst, beg + lim, item, out);
+}
+template<typename Itr, typename T, typename Less>
+bool exponential_search(Itr beg, Itr end, const T& item,
+						Less comp, Itr& out) {
+	//exponential (galloping) search, same result as binary_search but the cost grows with the distance of the insertion point from beg
+	//rather than with the size of the list, so is much quicker when the item belongs near the start
+	ptrdiff_t sze = distance(beg, end);
+	ptrdiff_t lst = 0;
+	ptrdiff_t ofs = 1;
+	//gallop forward 1, 3, 7, 15... items until we find one that is not less than the item
+	while(ofs <= sze && stlib_internal::less_func(*(beg + (ofs - 1)), item, comp)) {
+		lst = ofs;
+		ofs = ofs * 2 + 1;
+	}
+	//the insertion point is now between lst and ofs, binary search only this range
+	ptrdiff_t lim = (ofs < sze ? ofs : sze);
+	return binary_search(beg + lst, beg + lim, item, comp, out);
+}
 namespace stlib_internal {
+template<typename Itr, typename T>
+Itr exponential_search_upper(Itr beg, Itr end, const T& item) {
+	//as exponential_search, but returns the first element greater than the item
+	ptrdiff_t sze = distance(beg, end);
+	ptrdiff_t lst = 0;
+	ptrdiff_t ofs = 1;
+	while(ofs <= sze && !less_func(item, *(beg + (ofs - 1)))) {
+		lst = ofs;
+		ofs = ofs * 2 + 1;
+	}
+	Itr out = beg + lst;
+	ptrdiff_t count = (ofs < sze ? ofs : sze) - lst;
+	while(count > 0) {
+		ptrdiff_t step = count / 2;
+		Itr it = out + step;
+		if(!less_func(item, *it)) {
+			out = ++it;
+			count -= step + 1;
+		} else
+			count = step;
+	}
+	return out;
+}
+template<typename Itr, typename T, typename Comp>
+Itr exponential_search_upper(Itr beg, Itr end, const T& item, Comp cmp) {
+	//as exponential_search, but returns the first element greater than the item
+	ptrdiff_t sze = distance(beg, end);
+	ptrdiff_t lst = 0;
+	ptrdiff_t ofs = 1;
+	while(ofs <= sze && !less_func(item, *(beg + (ofs - 1)), cmp)) {
+		lst = ofs;
+		ofs = ofs * 2 + 1;
+	}
+	Itr out = beg + lst;
+	ptrdiff_t count = (ofs < sze ? ofs : sze) - lst;
+	while(count > 0) {
+		ptrdiff_t step = count / 2;
+		Itr it = out + step;
+		if(!less_func(item, *it, cmp)) {
+			out = ++it;
+			count -= step + 1;
+		} else
+			count = step;
+	}
+	return out;
+}
 template<typename Itr, typename IdxItr>
 bool stable_binary_search(Itr strt, Itr beg, Itr end, Itr item, IdxItr begidx,
 						  Itr& out) {
@@ -1072,19 +1536,14 @@ unsigned make_auxiliary_array(Itr strt, Itr end, typename stlib_internal::value_
 		unsigned idx = 0;
 		while(cnt > 0) {
 			Itr itr = strt + (cnt - 1);
-			construct(arr[idx], std::move(*itr));
+			stlib_internal::construct(arr[idx], std::move(*itr));
 			--cnt;
 			++idx;
 		}
 	} else {
 		//move this into the auxiliary array
-		unsigned idx = 0;
-		while(cnt > 0) {
-			Itr itr = strt + idx;
-			construct(arr[idx], std::move(*itr));
-			--cnt;
-			++idx;
-		}
+		typename stlib_internal::value_for<Itr>::value_type* out = arr;
+		stlib_internal::copy_buffers(strt, strt + cnt, out);
 	}
 	return count;
 }
@@ -1098,6 +1557,7 @@ void multi_insert(Itr beg, Itr strt_to, Itr strt, typename stlib_internal::value
 		if(count > 0) {
 			//do all of the comparisons on one go
 			//if the existing buffer is greater then, otherwise copy from the array
+			//(moving as we compare measured faster than finding the count then memmove, even on GCC)
 			Itr tmp = strt;
 			while(count > 0 && stlib_internal::greater_func(*tmp, arr[items - 1])) {
 				//do move after we know that this is greater
@@ -1176,19 +1636,14 @@ unsigned make_auxiliary_array(Itr strt, Itr end, typename stlib_internal::value_
 		unsigned idx = 0;
 		while(cnt > 0) {
 			Itr itr = strt + (cnt - 1);
-			construct(arr[idx], std::move(*itr));
+			stlib_internal::construct(arr[idx], std::move(*itr));
 			--cnt;
 			++idx;
 		}
 	} else {
 		//move this into the auxiliary array
-		unsigned idx = 0;
-		while(cnt > 0) {
-			Itr itr = strt + idx;
-			construct(arr[idx], std::move(*itr));
-			--cnt;
-			++idx;
-		}
+		typename stlib_internal::value_for<Itr>::value_type* out = arr;
+		stlib_internal::copy_buffers(strt, strt + cnt, out);
 	}
 	return count;
 }
@@ -1202,6 +1657,8 @@ void multi_insert(Itr beg, Itr strt_to, Itr strt, typename stlib_internal::value
 		if(count > 0) {
 			//do all of the comparisons on one go
 			//if the existing buffer is greater then, otherwise copy from the array
+			//(moving as we compare measured faster than finding the count then memmove, even on GCC)
+			Itr tmp = strt;
 			while(count > 0 && stlib_internal::greater_func(*tmp, arr[items - 1], cmp)) {
 				//do move after we know that this is greater
 				stlib_internal::construct(*strt_to, std::move(*tmp));
@@ -1242,6 +1699,181 @@ void multi_insertion_sort(Itr beg, Itr end, Comp cmp) {
 	}
 }
 
+namespace stlib_internal {
+template<typename SrcItr, typename DstItr>
+void parity_merge(SrcItr left, SrcItr right, SrcItr end, DstItr dst) {
+	//merge two sorted runs into dst without branching on the comparisons
+	using valueof = typename value_for<SrcItr>::value_type;
+	uint64_t sze1 = distance(left, right);
+	uint64_t sze2 = distance(right, end);
+	if(sze1 == sze2 && std::is_trivially_copyable<valueof>::value) {
+		//parity merge (as in quadsort), with equal runs filling from both ends at once for half the length each can never overrun
+		//the two ends can compare an item the other end has already taken, so only for items that are left as they are when moved
+		SrcItr lefttail = right - 1;
+		SrcItr righttail = end - 1;
+		DstItr dsttail = dst + (sze1 + sze2 - 1);
+		for(uint64_t i = 0; i < sze1; ++i) {
+			bool head = !less_func(*right, *left);
+			*dst++ = std::move(*(head ? left : right));
+			left += head;
+			right += !head;
+			bool tail = less_func(*righttail, *lefttail);
+			*dsttail-- = std::move(*(tail ? lefttail : righttail));
+			lefttail -= tail;
+			righttail -= !tail;
+		}
+		return;
+	}
+	SrcItr leftend = right;
+	while(left != leftend && right != end) {
+		bool head = !less_func(*right, *left);
+		*dst++ = std::move(*(head ? left : right));
+		left += head;
+		right += !head;
+	}
+	for(; left != leftend; ++left)
+		*dst++ = std::move(*left);
+	for(; right != end; ++right)
+		*dst++ = std::move(*right);
+}
+template<typename Itr>
+void parity_merge_small_sort(Itr beg, Itr end) {
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+	if(sze > INSERTION_SORT_CUTOFF) {
+		multi_insertion_sort(beg, end);
+		return;
+	}
+	alignas(valueof) char bufr[sizeof(valueof) * INSERTION_SORT_CUTOFF];
+	valueof* buf = (valueof*)bufr;
+
+	//sort each pair into the buffer
+	uint64_t i = 0;
+	for(; i + 1 < sze; i += 2) {
+		bool swp = less_func(*(beg + (i + 1)), *(beg + i));
+		construct(buf[i], std::move(*(swp ? beg + (i + 1) : beg + i)));
+		construct(buf[i + 1], std::move(*(swp ? beg + i : beg + (i + 1))));
+	}
+	if(i < sze)
+		construct(buf[i], std::move(*(beg + i)));
+
+	//then merge into blocks of 4, 8, 16 and 32 moving between the buffer and the list
+	bool inbuf = true;
+	for(uint64_t len = 2; len < sze; len *= 2) {
+		for(i = 0; i < sze; i += len * 2) {
+			uint64_t mid = (i + len < sze ? i + len : sze);
+			uint64_t last = (i + len * 2 < sze ? i + len * 2 : sze);
+			if(inbuf)
+				parity_merge(buf + i, buf + mid, buf + last, beg + i);
+			else
+				parity_merge(beg + i, beg + mid, beg + last, buf + i);
+		}
+		inbuf = !inbuf;
+	}
+
+	for(i = 0; i < sze; ++i) {
+		if(inbuf)
+			*(beg + i) = std::move(buf[i]);
+		destruct(buf[i]);
+	}
+}
+template<typename Itr>
+inline void small_sort(Itr beg, Itr end, SMALL_SORT_KIND kind) {
+	if(kind == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+		parity_merge_small_sort(beg, end);
+	else
+		multi_insertion_sort(beg, end);
+}
+template<typename SrcItr, typename DstItr, typename Comp>
+void parity_merge(SrcItr left, SrcItr right, SrcItr end, DstItr dst, Comp cmp) {
+	//merge two sorted runs into dst without branching on the comparisons
+	using valueof = typename value_for<SrcItr>::value_type;
+	uint64_t sze1 = distance(left, right);
+	uint64_t sze2 = distance(right, end);
+	if(sze1 == sze2 && std::is_trivially_copyable<valueof>::value) {
+		//parity merge (as in quadsort), with equal runs filling from both ends at once for half the length each can never overrun
+		//the two ends can compare an item the other end has already taken, so only for items that are left as they are when moved
+		SrcItr lefttail = right - 1;
+		SrcItr righttail = end - 1;
+		DstItr dsttail = dst + (sze1 + sze2 - 1);
+		for(uint64_t i = 0; i < sze1; ++i) {
+			bool head = !less_func(*right, *left, cmp);
+			*dst++ = std::move(*(head ? left : right));
+			left += head;
+			right += !head;
+			bool tail = less_func(*righttail, *lefttail, cmp);
+			*dsttail-- = std::move(*(tail ? lefttail : righttail));
+			lefttail -= tail;
+			righttail -= !tail;
+		}
+		return;
+	}
+	SrcItr leftend = right;
+	while(left != leftend && right != end) {
+		bool head = !less_func(*right, *left, cmp);
+		*dst++ = std::move(*(head ? left : right));
+		left += head;
+		right += !head;
+	}
+	for(; left != leftend; ++left)
+		*dst++ = std::move(*left);
+	for(; right != end; ++right)
+		*dst++ = std::move(*right);
+}
+template<typename Itr, typename Comp>
+void parity_merge_small_sort(Itr beg, Itr end, Comp cmp) {
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+	if(sze > INSERTION_SORT_CUTOFF) {
+		multi_insertion_sort(beg, end, cmp);
+		return;
+	}
+	alignas(valueof) char bufr[sizeof(valueof) * INSERTION_SORT_CUTOFF];
+	valueof* buf = (valueof*)bufr;
+
+	//sort each pair into the buffer
+	uint64_t i = 0;
+	for(; i + 1 < sze; i += 2) {
+		bool swp = less_func(*(beg + (i + 1)), *(beg + i), cmp);
+		construct(buf[i], std::move(*(swp ? beg + (i + 1) : beg + i)));
+		construct(buf[i + 1], std::move(*(swp ? beg + i : beg + (i + 1))));
+	}
+	if(i < sze)
+		construct(buf[i], std::move(*(beg + i)));
+
+	//then merge into blocks of 4, 8, 16 and 32 moving between the buffer and the list
+	bool inbuf = true;
+	for(uint64_t len = 2; len < sze; len *= 2) {
+		for(i = 0; i < sze; i += len * 2) {
+			uint64_t mid = (i + len < sze ? i + len : sze);
+			uint64_t last = (i + len * 2 < sze ? i + len * 2 : sze);
+			if(inbuf)
+				parity_merge(buf + i, buf + mid, buf + last, beg + i, cmp);
+			else
+				parity_merge(beg + i, beg + mid, beg + last, buf + i, cmp);
+		}
+		inbuf = !inbuf;
+	}
+
+	for(i = 0; i < sze; ++i) {
+		if(inbuf)
+			*(beg + i) = std::move(buf[i]);
+		destruct(buf[i]);
+	}
+}
+template<typename Itr, typename Comp>
+inline void small_sort(Itr beg, Itr end, Comp cmp, SMALL_SORT_KIND kind) {
+	if(kind == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+		parity_merge_small_sort(beg, end, cmp);
+	else
+		multi_insertion_sort(beg, end, cmp);
+}
+}
+
 
 template<typename Itr>
 void binary_insertion_sort(Itr beg, Itr end) {
@@ -1415,10 +2047,180 @@ void double_selection_sort(Itr beg, Itr end, Comp cmp) {
 }
 
 
+enum class PARTITION_KIND : uint8_t {
+	//one pivot (median of three or four), items equal to the pivot go to the right
+	PK_SINGLE_PIVOT,
+	//two pivots from a sorted sample of five, partitions into three parts in one pass (as Java's Arrays.sort)
+	PK_DUAL_PIVOT
+};
+namespace stlib_internal {
+template<typename Itr>
+void dual_pivot_select(Itr beg, Itr end) {
+	//sort five evenly spread items, the second and fourth are the pivots, move them to either end
+	auto step = distance(beg, end) / 6;
+	Itr smp[5] = {beg + step, beg + 2 * step, beg + 3 * step, beg + 4 * step, beg + 5 * step};
+	for(unsigned i = 1; i < 5; ++i)
+		for(unsigned j = i; j > 0 && less_func(*smp[j], *smp[j - 1]); --j)
+			std::swap(*smp[j], *smp[j - 1]);
+	std::swap(*beg, *smp[1]);
+	std::swap(*(end - 1), *smp[3]);
+}
+template<typename Itr>
+void dual_pivot_partition(Itr beg, Itr end, Itr& lt, Itr& gt) {
+	//the pivots are at beg and end - 1, split into less than the first, between the two and greater than the second in one pass
+	Itr less = beg + 1;
+	Itr great = end - 2;
+	for(Itr crnt = less; crnt <= great; ++crnt) {
+		if(less_func(*crnt, *beg)) {
+			std::swap(*crnt, *less);
+			++less;
+		} else if(less_func(*(end - 1), *crnt)) {
+			//skip over the items already on the right side
+			while(crnt != great && less_func(*(end - 1), *great))
+				--great;
+			std::swap(*crnt, *great);
+			--great;
+			if(less_func(*crnt, *beg)) {
+				std::swap(*crnt, *less);
+				++less;
+			}
+		}
+	}
+	//move the pivots into place
+	lt = less - 1;
+	gt = great + 1;
+	std::swap(*beg, *lt);
+	std::swap(*(end - 1), *gt);
+}
+template<typename Itr>
+void dual_pivot_intro_quick_sort_internal(Itr beg, Itr end, DEPTH_FALLBACK_KIND fallback, SMALL_SORT_KIND small) {
+	if(distance(beg, end) <= INSERTION_SORT_CUTOFF)
+		return;
+	unsigned maxdepth = get_depth(distance(beg, end));
+
+	//add a stack item
+	std::vector<intro_stack_less_data<Itr>> stk;
+	stk.resize(15);
+	size_t idx = 0;
+	intro_stack_less_data<Itr> dat = {
+		beg,
+		end - 1,
+		maxdepth
+	};
+	stk[idx++] = std::move(dat);
+
+	while(idx > 0) {
+		intro_stack_less_data<Itr> tmp = stk[--idx];
+		Itr lt;
+		Itr gt;
+		dual_pivot_select(tmp.beg, tmp.end + 1);
+		dual_pivot_partition(tmp.beg, tmp.end + 1, lt, gt);
+
+		//leave small partitions for multi_insertion_sort, or sort them now with the parity merge
+		if(distance(gt + 1, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+			add_stack_item(gt + 1, tmp.end + 1, gt + 1, tmp.end, tmp.depth, stk, idx, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+			parity_merge_small_sort(gt + 1, tmp.end + 1);
+		//if the pivots are equal then so is everything between them
+		if(distance(lt + 1, gt) > INSERTION_SORT_CUTOFF && less_func(*lt, *gt))
+			add_stack_item(lt + 1, gt, lt + 1, gt - 1, tmp.depth, stk, idx, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE && less_func(*lt, *gt))
+			parity_merge_small_sort(lt + 1, gt);
+		if(distance(tmp.beg, lt) > INSERTION_SORT_CUTOFF)
+			add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+			parity_merge_small_sort(tmp.beg, lt);
+	}
+}
+template<typename Itr, typename Comp>
+void dual_pivot_select(Itr beg, Itr end, Comp cmp) {
+	//sort five evenly spread items, the second and fourth are the pivots, move them to either end
+	auto step = distance(beg, end) / 6;
+	Itr smp[5] = {beg + step, beg + 2 * step, beg + 3 * step, beg + 4 * step, beg + 5 * step};
+	for(unsigned i = 1; i < 5; ++i)
+		for(unsigned j = i; j > 0 && less_func(*smp[j], *smp[j - 1], cmp); --j)
+			std::swap(*smp[j], *smp[j - 1]);
+	std::swap(*beg, *smp[1]);
+	std::swap(*(end - 1), *smp[3]);
+}
+template<typename Itr, typename Comp>
+void dual_pivot_partition(Itr beg, Itr end, Itr& lt, Itr& gt, Comp cmp) {
+	//the pivots are at beg and end - 1, split into less than the first, between the two and greater than the second in one pass
+	Itr less = beg + 1;
+	Itr great = end - 2;
+	for(Itr crnt = less; crnt <= great; ++crnt) {
+		if(less_func(*crnt, *beg, cmp)) {
+			std::swap(*crnt, *less);
+			++less;
+		} else if(less_func(*(end - 1), *crnt, cmp)) {
+			//skip over the items already on the right side
+			while(crnt != great && less_func(*(end - 1), *great, cmp))
+				--great;
+			std::swap(*crnt, *great);
+			--great;
+			if(less_func(*crnt, *beg, cmp)) {
+				std::swap(*crnt, *less);
+				++less;
+			}
+		}
+	}
+	//move the pivots into place
+	lt = less - 1;
+	gt = great + 1;
+	std::swap(*beg, *lt);
+	std::swap(*(end - 1), *gt);
+}
+template<typename Itr, typename Comp>
+void dual_pivot_intro_quick_sort_internal(Itr beg, Itr end, Comp cmp, DEPTH_FALLBACK_KIND fallback, SMALL_SORT_KIND small) {
+	if(distance(beg, end) <= INSERTION_SORT_CUTOFF)
+		return;
+	unsigned maxdepth = get_depth(distance(beg, end));
+
+	//add a stack item
+	std::vector<intro_stack_less_data<Itr>> stk;
+	stk.resize(15);
+	size_t idx = 0;
+	intro_stack_less_data<Itr> dat = {
+		beg,
+		end - 1,
+		maxdepth
+	};
+	stk[idx++] = std::move(dat);
+
+	while(idx > 0) {
+		intro_stack_less_data<Itr> tmp = stk[--idx];
+		Itr lt;
+		Itr gt;
+		dual_pivot_select(tmp.beg, tmp.end + 1, cmp);
+		dual_pivot_partition(tmp.beg, tmp.end + 1, lt, gt, cmp);
+
+		//leave small partitions for multi_insertion_sort, or sort them now with the parity merge
+		if(distance(gt + 1, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+			add_stack_item(gt + 1, tmp.end + 1, gt + 1, tmp.end, tmp.depth, stk, idx, cmp, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+			parity_merge_small_sort(gt + 1, tmp.end + 1, cmp);
+		//if the pivots are equal then so is everything between them
+		if(distance(lt + 1, gt) > INSERTION_SORT_CUTOFF && less_func(*lt, *gt, cmp))
+			add_stack_item(lt + 1, gt, lt + 1, gt - 1, tmp.depth, stk, idx, cmp, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE && less_func(*lt, *gt, cmp))
+			parity_merge_small_sort(lt + 1, gt, cmp);
+		if(distance(tmp.beg, lt) > INSERTION_SORT_CUTOFF)
+			add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, cmp, fallback);
+		else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+			parity_merge_small_sort(tmp.beg, lt, cmp);
+	}
+}
+}
+
 template<typename Itr>
-void quick_sort(Itr beg, Itr end) {
+void quick_sort(Itr beg, Itr end, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT) {
 	if(distance(beg, end) <= 1)
 		return;
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT) {
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+		multi_insertion_sort(beg, end);
+		return;
+	}
 	std::vector<stlib_internal::stack_less_data<Itr>> stk;
 	stk.resize(15);
 	size_t idx = 0;
@@ -1478,9 +2280,14 @@ void quick_sort(Itr beg, Itr end) {
 	}
 }
 template<typename Itr, typename Comp>
-void quick_sort(Itr beg, Itr end, Comp cmp) {
+void quick_sort(Itr beg, Itr end, Comp cmp, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT) {
 	if(distance(beg, end) <= 1)
 		return;
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT) {
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, cmp, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+		multi_insertion_sort(beg, end, cmp);
+		return;
+	}
 	std::vector<stlib_internal::stack_less_data<Itr>> stk;
 	stk.resize(15);
 	size_t idx = 0;
@@ -1542,23 +2349,107 @@ void quick_sort(Itr beg, Itr end, Comp cmp) {
 
 namespace stlib_internal {
 template<typename Itr, typename IdxItr>
-void stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx) {
-	if(distance(beg, end) <= 1)
+Itr stable_partition_equal(Itr beg, Itr first, Itr last, Itr pivot, IdxItr begidx) {
+	//no key in [first, last) is less than the pivot key, move the keys equal to it to the left and return the end of them
+	//(only the keys are compared so the equal items lose their order here, stable_quick_sort_restore_order puts it back)
+	stable_quick_sort_swap(beg, first, pivot, begidx);
+	Itr left = first + 1;
+	Itr right = last;
+	for(;;) {
+		while(left != right && !less_func(*first, *left))
+			++left;
+		while(left != right && less_func(*first, *(right - 1)))
+			--right;
+		if(left == right)
+			return left;
+		--right;
+		stable_quick_sort_swap(beg, left, right, begidx);
+		++left;
+	}
+}
+template<typename Itr, typename IdxItr>
+void stable_quick_sort_restore_order(Itr beg, Itr first, Itr last, IdxItr begidx) {
+	//all the items in [first, last) are equal, put them back into their original order using only their indexes
+	using valueof = typename value_for<Itr>::value_type;
+	using idxof = typename value_for<IdxItr>::value_type;
+	IdxItr bidx = begidx + distance(beg, first);
+	IdxItr eidx = begidx + distance(beg, last);
+	if(distance(first, last) <= INSERTION_SORT_CUTOFF) {
+		stable_insertion_sort(first, last, bidx);
 		return;
-	std::vector<stack_less_data<Itr>> stk;
-	stk.resize(15);
-	size_t idx = 0;
-	stack_less_data<Itr> dat = {
-		beg,
-		end - 1
-	};
-	stk[idx++] = std::move(dat);
+	}
+	if(stlib::is_sorted(bidx, eidx))
+		return;
+	//sort the indexes along with where each item is now
+	std::vector<std::pair<idxof, size_t>> order;
+	order.reserve(distance(first, last));
+	for(IdxItr it = bidx; it != eidx; ++it)
+		order.push_back(std::make_pair(*it, (size_t)distance(bidx, it)));
+	stlib::sort(order.begin(), order.end());
+
+	//the item that belongs at i is now at order[i].second, follow the cycles so each item is only moved once
+	for(size_t i = 0; i < order.size(); ++i) {
+		*(bidx + i) = order[i].first;
+		if(order[i].second == i)
+			continue;
+		valueof tmp = std::move(*(first + i));
+		size_t crnt = i;
+		while(order[crnt].second != i) {
+			size_t nxt = order[crnt].second;
+			*(first + crnt) = std::move(*(first + nxt));
+			order[crnt].second = crnt;
+			crnt = nxt;
+		}
+		*(first + crnt) = std::move(tmp);
+		order[crnt].second = crnt;
+	}
+}
+template<typename Itr, typename IdxItr, typename Comp>
+Itr stable_partition_equal(Itr beg, Itr first, Itr last, Itr pivot, IdxItr begidx, Comp cmp) {
+	//no key in [first, last) is less than the pivot key, move the keys equal to it to the left and return the end of them
+	//(only the keys are compared so the equal items lose their order here, stable_quick_sort_restore_order puts it back)
+	stable_quick_sort_swap(beg, first, pivot, begidx);
+	Itr left = first + 1;
+	Itr right = last;
+	for(;;) {
+		while(left != right && !less_func(*first, *left, cmp))
+			++left;
+		while(left != right && less_func(*first, *(right - 1), cmp))
+			--right;
+		if(left == right)
+			return left;
+		--right;
+		stable_quick_sort_swap(beg, left, right, begidx);
+		++left;
+	}
+}
+template<typename Itr, typename IdxItr>
+void stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx) {
+	if(distance(beg, end) <= 1)
+		return;
+	std::vector<stack_less_data<Itr>> stk;
+	stk.resize(15);
+	size_t idx = 0;
+	stack_less_data<Itr> dat = {
+		beg,
+		end - 1
+	};
+	stk[idx++] = std::move(dat);
 
 	while(idx > 0) {
 		stack_less_data<Itr> tmp = stk[--idx];
 		Itr left = tmp.beg - 1;
 		Itr right = tmp.end + 1;
 		Itr pivot = middle_of_three(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > 1)
+				add_stack_item(mid, tmp.end, stk, idx);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1635,6 +2526,15 @@ void adaptive_stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx) {
 		Itr right = tmp.end + 1;
 		unsigned swaps = 0;
 		Itr pivot = stable_middle_of_four(beg, tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, begidx);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > 1)
+				add_stack_item(mid, tmp.end, stk, idx);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1684,7 +2584,7 @@ void adaptive_stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx) {
 	}
 }
 template<typename Itr, typename IdxItr>
-void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx) {
+void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx, DEPTH_FALLBACK_KIND fallback) {
 	if(distance(beg, end) <= 1)
 		return;
 	unsigned maxdepth = get_depth(distance(beg, end));
@@ -1706,6 +2606,15 @@ void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx) {
 		Itr right = tmp.end + 1;
 		unsigned swaps = 0;
 		Itr pivot = stable_middle_of_four(beg, tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, begidx);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				stable_add_stack_item(beg, mid, tmp.end + 1, mid, tmp.end, begidx, tmp.depth, stk, idx, fallback);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1743,14 +2652,14 @@ void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx) {
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx);
+				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, fallback);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx);
+				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, fallback);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx);
+				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, fallback);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx);
+				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, fallback);
 		}
 	}
 }
@@ -1766,14 +2675,14 @@ void adaptive_stable_quick_sort(Itr beg, Itr end) {
 	stlib_internal::adaptive_stable_quick_sort_internal(beg, end, idxs.begin());
 }
 template<typename Itr>
-void adaptive_stable_intro_sort(Itr beg, Itr end) {
+void adaptive_stable_intro_sort(Itr beg, Itr end, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_MERGE_SORT) {
 	if(distance(beg, end) <= 1)
 		return;
 	std::vector<size_t> idxs;
 	idxs.resize(distance(beg, end));
 	for(size_t i = 0; i < idxs.size(); ++i)
 		idxs[i] = i;
-	stlib_internal::adaptive_stable_intro_sort_internal(beg, end, idxs.begin());
+	stlib_internal::adaptive_stable_intro_sort_internal(beg, end, idxs.begin(), fallback);
 
 	stlib_internal::stable_insertion_sort(beg, end, idxs.begin());
 }
@@ -1796,6 +2705,15 @@ void stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp cmp) {
 		Itr left = tmp.beg - 1;
 		Itr right = tmp.end + 1;
 		Itr pivot = middle_of_three(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, cmp);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot, cmp)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx, cmp);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > 1)
+				add_stack_item(mid, tmp.end, stk, idx);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1872,6 +2790,15 @@ void adaptive_stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp c
 		Itr right = tmp.end + 1;
 		unsigned swaps = 0;
 		Itr pivot = stable_middle_of_four(beg, tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, begidx, cmp);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot, cmp)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx, cmp);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > 1)
+				add_stack_item(mid, tmp.end, stk, idx);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1921,7 +2848,7 @@ void adaptive_stable_quick_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp c
 	}
 }
 template<typename Itr, typename IdxItr, typename Comp>
-void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp cmp) {
+void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp cmp, DEPTH_FALLBACK_KIND fallback) {
 	if(distance(beg, end) <= 1)
 		return;
 	unsigned maxdepth = get_depth(distance(beg, end));
@@ -1943,6 +2870,15 @@ void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp c
 		Itr right = tmp.end + 1;
 		unsigned swaps = 0;
 		Itr pivot = stable_middle_of_four(beg, tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, begidx, cmp);
+		//the item before this partition is no greater than anything in it, if its key is equal to the pivot then every item
+		//with that key is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot, cmp)) {
+			Itr mid = stable_partition_equal(beg, tmp.beg, tmp.end + 1, pivot, begidx, cmp);
+			stable_quick_sort_restore_order(beg, tmp.beg, mid, begidx);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				stable_add_stack_item(beg, mid, tmp.end + 1, mid, tmp.end, begidx, tmp.depth, stk, idx, cmp, fallback);
+			continue;
+		}
 
 		do {
 			++left;
@@ -1980,14 +2916,14 @@ void adaptive_stable_intro_sort_internal(Itr beg, Itr end, IdxItr begidx, Comp c
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, cmp);
+				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, cmp, fallback);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, cmp);
+				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, cmp, fallback);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, cmp);
+				stable_add_stack_item(beg, pivot + 1, tmp.end + 1, pivot + 1, tmp.end, begidx, tmp.depth, stk, idx, cmp, fallback);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, cmp);
+				stable_add_stack_item(beg, tmp.beg, pivot, tmp.beg, pivot - 1, begidx, tmp.depth, stk, idx, cmp, fallback);
 		}
 	}
 }
@@ -2003,18 +2939,188 @@ void adaptive_stable_quick_sort(Itr beg, Itr end, Comp cmp) {
 	stlib_internal::adaptive_stable_quick_sort_internal(beg, end, idxs.begin(), cmp);
 }
 template<typename Itr, typename Comp>
-void adaptive_stable_intro_sort(Itr beg, Itr end, Comp cmp) {
+void adaptive_stable_intro_sort(Itr beg, Itr end, Comp cmp, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_MERGE_SORT) {
 	if(distance(beg, end) <= 1)
 		return;
 	std::vector<size_t> idxs;
 	idxs.resize(distance(beg, end));
 	for(size_t i = 0; i < idxs.size(); ++i)
 		idxs[i] = i;
-	stlib_internal::adaptive_stable_intro_sort_internal(beg, end, idxs.begin(), cmp);
+	stlib_internal::adaptive_stable_intro_sort_internal(beg, end, idxs.begin(), cmp, fallback);
 
 	stlib_internal::stable_insertion_sort(beg, end, idxs.begin(), cmp);
 }
 
+namespace stlib_internal {
+template<typename Itr, typename T>
+Itr inplace_stable_partition(Itr beg, Itr end, const T& pivot, bool equal, T* bufr, uint64_t bufr_count) {
+	//moves the items less than the pivot (or if equal is set, the items not greater than the pivot) to the front keeping their order
+	//items already at the front are in place
+	while(beg != end && (equal ? !less_func(pivot, *beg) : less_func(*beg, pivot)))
+		++beg;
+	uint64_t sze = distance(beg, end);
+	if(sze == 0)
+		return beg;
+	if(sze <= bufr_count) {
+		//move the items that are not moved to the front into the buffer, then put them back at the end
+		uint64_t count = 0;
+		Itr out = beg;
+		for(Itr crnt = beg; crnt != end; ++crnt) {
+			if(equal ? !less_func(pivot, *crnt) : less_func(*crnt, pivot))
+				construct(*out++, std::move(*crnt));
+			else
+				construct(bufr[count++], std::move(*crnt));
+		}
+		Itr mid = out;
+		for(uint64_t i = 0; i < count; ++i, ++out) {
+			construct(*out, std::move(bufr[i]));
+			destruct(bufr[i]);
+		}
+		return mid;
+	}
+	//partition each half, then rotate the back of the first half with the front of the second
+	Itr mid = beg + (sze / 2);
+	Itr left = inplace_stable_partition(beg, mid, pivot, equal, bufr, bufr_count);
+	Itr right = inplace_stable_partition(mid, end, pivot, equal, bufr, bufr_count);
+	stlib_internal::rotate(left, mid, right);
+	return left + distance(mid, right);
+}
+}
+template<typename Itr>
+void inplace_stable_quick_sort(Itr beg, Itr end) {
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	if(distance(beg, end) <= 1)
+		return;
+	//a small fixed buffer for the stable partition, so no index array is needed to break ties
+	constexpr uint64_t buffer_count = (STABLE_PARTITION_BUFFER_BYTES/sizeof(valueof) > 0 ? STABLE_PARTITION_BUFFER_BYTES/sizeof(valueof) : 1);
+	alignas(valueof) char bufr[buffer_count * sizeof(valueof)];
+
+	std::vector<stlib_internal::intro_stack_less_data<Itr>> stk;
+	stk.resize(15);
+	size_t idx = 0;
+	unsigned maxdepth = stlib_internal::get_depth(distance(beg, end));
+	stlib_internal::intro_stack_less_data<Itr> dat = {
+		beg,
+		end - 1,
+		maxdepth
+	};
+	stk[idx++] = std::move(dat);
+
+	while(idx > 0) {
+		stlib_internal::intro_stack_less_data<Itr> tmp = stk[--idx];
+		if(distance(tmp.beg, tmp.end + 1) <= INSERTION_SORT_CUTOFF) {
+			multi_insertion_sort(tmp.beg, tmp.end + 1);
+			continue;
+		}
+
+		//the pivot moves while partitioning so keep a copy
+		valueof pivot(*stlib_internal::middle_of_three(tmp.beg, stlib_internal::half_point(tmp.beg, tmp.end + 1), tmp.end));
+
+		//split into less than, equal to and greater than the pivot, the items equal to the pivot are then in place
+		Itr lt = stlib_internal::inplace_stable_partition(tmp.beg, tmp.end + 1, pivot, false, (valueof*)bufr, buffer_count);
+		Itr gt = stlib_internal::inplace_stable_partition(lt, tmp.end + 1, pivot, true, (valueof*)bufr, buffer_count);
+
+		//implements sort shorter first optimisation, the depth limit falls back to a constant memory stable sort
+		auto dist1 = distance(gt, tmp.end + 1);
+		auto dist2 = distance(tmp.beg, lt);
+		if(dist1 < dist2) {
+			if(dist2 > 1)
+				stlib_internal::add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+			if(dist1 > 1)
+				stlib_internal::add_stack_item(gt, tmp.end + 1, gt, tmp.end, tmp.depth, stk, idx, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+		} else {
+			if(dist1 > 1)
+				stlib_internal::add_stack_item(gt, tmp.end + 1, gt, tmp.end, tmp.depth, stk, idx, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+			if(dist2 > 1)
+				stlib_internal::add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+		}
+	}
+}
+namespace stlib_internal {
+template<typename Itr, typename T, typename Comp>
+Itr inplace_stable_partition(Itr beg, Itr end, const T& pivot, bool equal, T* bufr, uint64_t bufr_count, Comp cmp) {
+	//moves the items less than the pivot (or if equal is set, the items not greater than the pivot) to the front keeping their order
+	//items already at the front are in place
+	while(beg != end && (equal ? !less_func(pivot, *beg, cmp) : less_func(*beg, pivot, cmp)))
+		++beg;
+	uint64_t sze = distance(beg, end);
+	if(sze == 0)
+		return beg;
+	if(sze <= bufr_count) {
+		//move the items that are not moved to the front into the buffer, then put them back at the end
+		uint64_t count = 0;
+		Itr out = beg;
+		for(Itr crnt = beg; crnt != end; ++crnt) {
+			if(equal ? !less_func(pivot, *crnt, cmp) : less_func(*crnt, pivot, cmp))
+				construct(*out++, std::move(*crnt));
+			else
+				construct(bufr[count++], std::move(*crnt));
+		}
+		Itr mid = out;
+		for(uint64_t i = 0; i < count; ++i, ++out) {
+			construct(*out, std::move(bufr[i]));
+			destruct(bufr[i]);
+		}
+		return mid;
+	}
+	//partition each half, then rotate the back of the first half with the front of the second
+	Itr mid = beg + (sze / 2);
+	Itr left = inplace_stable_partition(beg, mid, pivot, equal, bufr, bufr_count, cmp);
+	Itr right = inplace_stable_partition(mid, end, pivot, equal, bufr, bufr_count, cmp);
+	stlib_internal::rotate(left, mid, right);
+	return left + distance(mid, right);
+}
+}
+template<typename Itr, typename Comp>
+void inplace_stable_quick_sort(Itr beg, Itr end, Comp cmp) {
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	if(distance(beg, end) <= 1)
+		return;
+	//a small fixed buffer for the stable partition, so no index array is needed to break ties
+	constexpr uint64_t buffer_count = (STABLE_PARTITION_BUFFER_BYTES/sizeof(valueof) > 0 ? STABLE_PARTITION_BUFFER_BYTES/sizeof(valueof) : 1);
+	alignas(valueof) char bufr[buffer_count * sizeof(valueof)];
+
+	std::vector<stlib_internal::intro_stack_less_data<Itr>> stk;
+	stk.resize(15);
+	size_t idx = 0;
+	unsigned maxdepth = stlib_internal::get_depth(distance(beg, end));
+	stlib_internal::intro_stack_less_data<Itr> dat = {
+		beg,
+		end - 1,
+		maxdepth
+	};
+	stk[idx++] = std::move(dat);
+
+	while(idx > 0) {
+		stlib_internal::intro_stack_less_data<Itr> tmp = stk[--idx];
+		if(distance(tmp.beg, tmp.end + 1) <= INSERTION_SORT_CUTOFF) {
+			multi_insertion_sort(tmp.beg, tmp.end + 1, cmp);
+			continue;
+		}
+
+		//the pivot moves while partitioning so keep a copy
+		valueof pivot(*stlib_internal::middle_of_three(tmp.beg, stlib_internal::half_point(tmp.beg, tmp.end + 1), tmp.end, cmp));
+
+		//split into less than, equal to and greater than the pivot, the items equal to the pivot are then in place
+		Itr lt = stlib_internal::inplace_stable_partition(tmp.beg, tmp.end + 1, pivot, false, (valueof*)bufr, buffer_count, cmp);
+		Itr gt = stlib_internal::inplace_stable_partition(lt, tmp.end + 1, pivot, true, (valueof*)bufr, buffer_count, cmp);
+
+		//implements sort shorter first optimisation, the depth limit falls back to a constant memory stable sort
+		auto dist1 = distance(gt, tmp.end + 1);
+		auto dist2 = distance(tmp.beg, lt);
+		if(dist1 < dist2) {
+			if(dist2 > 1)
+				stlib_internal::add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, cmp, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+			if(dist1 > 1)
+				stlib_internal::add_stack_item(gt, tmp.end + 1, gt, tmp.end, tmp.depth, stk, idx, cmp, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+		} else {
+			if(dist1 > 1)
+				stlib_internal::add_stack_item(gt, tmp.end + 1, gt, tmp.end, tmp.depth, stk, idx, cmp, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+			if(dist2 > 1)
+				stlib_internal::add_stack_item(tmp.beg, lt, tmp.beg, lt - 1, tmp.depth, stk, idx, cmp, DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT);
+		}
+	}
+}
 
 template<typename Itr>
 bool stack_quick_sort(Itr beg, Itr end, uint32_t limit = 100) {
@@ -2484,15 +3590,43 @@ void merge_internal(Itr1 beg1, Itr1 beg2, Itr1 end2, Itr2& begout, Comp cmp) {
 	Itr1 end1 = beg2;
 
 	//go through both lists, build the sorted list
-	for(; beg1 != end1 && beg2 != end2; ++begout)
-		if(less_func(*beg2, *beg1, cmp)) {
-			construct(*begout, std::move(*beg2));
-			++beg2;
-		} else {
-			construct(*begout, std::move(*beg1));
-			++beg1;
+	uint64_t min_gallop = MERGE_MIN_GALLOP;
+	while(beg1 != end1 && beg2 != end2) {
+		//if the next min_gallop items of one list all come before the other list then gallop (as in TimSort)
+		//find the whole run with an exponential search and move it at once, each time this pays off make it easier to start galloping
+		if((uint64_t)distance(beg1, end1) > min_gallop && !less_func(*beg2, *(beg1 + min_gallop), cmp)) {
+			Itr1 it = exponential_search_upper(beg1 + (min_gallop + 1), end1, *beg2, cmp);
+			copy_buffers(beg1, it, begout);
+			beg1 = it;
+			if(min_gallop > MERGE_MIN_GALLOP)
+				min_gallop /= 2;
+			continue;
+		}
+		if((uint64_t)distance(beg2, end2) > min_gallop && less_func(*(beg2 + min_gallop), *beg1, cmp)) {
+			Itr1 it;
+			exponential_search(beg2 + (min_gallop + 1), end2, *beg1, cmp, it);
+			copy_buffers(beg2, it, begout);
+			beg2 = it;
+			if(min_gallop > MERGE_MIN_GALLOP)
+				min_gallop /= 2;
+			continue;
 		}
 
+		//otherwise merge item by item until one of the lists has moved min_gallop items, then check again
+		//galloping didn't pay off here, make it harder to start
+		Itr1 lim1 = ((uint64_t)distance(beg1, end1) > min_gallop ? beg1 + min_gallop : end1);
+		Itr1 lim2 = ((uint64_t)distance(beg2, end2) > min_gallop ? beg2 + min_gallop : end2);
+		for(; beg1 != lim1 && beg2 != lim2; ++begout)
+			if(less_func(*beg2, *beg1, cmp)) {
+				construct(*begout, std::move(*beg2));
+				++beg2;
+			} else {
+				construct(*begout, std::move(*beg1));
+				++beg1;
+			}
+		min_gallop *= 2;
+	}
+
 	//finish off copy back of remaining lists (if any)
 	copy_buffers(beg1, end1, begout);
 	copy_buffers(beg2, end2, begout);
@@ -2573,18 +3707,34 @@ bool merge_sort(Itr beg, Itr end, Comp cmp) {
 	}
 	return false;
 }
+template<typename Itr, typename Comp>
+bool merge_sort(Itr beg, Itr end, Comp cmp, scratch_arena& arena) {
+	if(distance(beg, end) <= 1)
+		return true;
+	//same as above but the buffer is kept in the arena for the next sort
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::scratch_arena_acquire(arena, distance(beg, end) * sizeof(valueof));
+	if(buf) {
+		stlib_internal::merge_sort_internal(beg, end, buf, cmp);
+		return true;
+	}
+	return false;
+}
 namespace stlib_internal {
 bool start_out_of_place_merge(uint64_t sze, uint64_t insert_count);
 template<typename Itr, typename T, typename Comp>
 void out_of_place_insertion_sort(Itr beg, Itr end, T* buf, Comp cmp) {
-	if(distance(beg, end) <= 1)
+	if(distance(beg, end) <= 1) {
+		//a single item still needs moving to the output
+		copy_buffers(beg, end, buf);
 		return;
+	}
 
 	//do an insertion sort but copying the array to a different destination
 	T* lsted = buf;
 	for(Itr strt = beg; strt != end; ++strt, ++lsted) {
 		T* led = lsted;
-		while(led != buf && greater_func(*(led - 1), *strt), cmp) {
+		while(led != buf && greater_func(*(led - 1), *strt, cmp)) {
 			construct(*led, std::move(*(led - 1)));
 			--led;
 		}
@@ -2593,8 +3743,11 @@ void out_of_place_insertion_sort(Itr beg, Itr end, T* buf, Comp cmp) {
 }
 template<typename Itr, typename T, typename Comp>
 void out_of_place_multi_insertion_sort(Itr beg, Itr end, T* buf, Comp cmp) {
-	if(distance(beg, end) <= 1)
+	if(distance(beg, end) <= 1) {
+		//a single item still needs moving to the output
+		copy_buffers(beg, end, buf);
 		return;
+	}
 
 	//move this to the correct place (do insert)
 	using valueof = typename stlib_internal::value_for<Itr>::value_type;
@@ -2717,6 +3870,19 @@ bool hybrid_merge_sort(Itr beg, Itr end, Comp cmp) {
 	}
 	return false;
 }
+template<typename Itr, typename Comp>
+bool hybrid_merge_sort(Itr beg, Itr end, Comp cmp, scratch_arena& arena) {
+	if(distance(beg, end) <= 1)
+		return true;
+	//same as above but the buffer is kept in the arena for the next sort
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::scratch_arena_acquire(arena, distance(beg, end) * sizeof(valueof));
+	if(buf) {
+		stlib_internal::hybrid_merge_sort_internal(beg, end, buf, cmp);
+		return true;
+	}
+	return false;
+}
 
 namespace stlib_internal {
 template<typename Itr1, typename Itr2>
@@ -2724,14 +3890,42 @@ void merge_internal(Itr1 beg1, Itr1 beg2, Itr1 end2, Itr2& begout) {
 	Itr1 end1 = beg2;
 
 	//go through both lists, build the sorted list
-	for(; beg1 != end1 && beg2 != end2; ++begout)
-		if(less_func(*beg2, *beg1)) {
-			construct(*begout, std::move(*beg2));
-			++beg2;
-		} else {
-			construct(*begout, std::move(*beg1));
-			++beg1;
+	uint64_t min_gallop = MERGE_MIN_GALLOP;
+	while(beg1 != end1 && beg2 != end2) {
+		//if the next min_gallop items of one list all come before the other list then gallop (as in TimSort)
+		//find the whole run with an exponential search and move it at once, each time this pays off make it easier to start galloping
+		if((uint64_t)distance(beg1, end1) > min_gallop && !less_func(*beg2, *(beg1 + min_gallop))) {
+			Itr1 it = exponential_search_upper(beg1 + (min_gallop + 1), end1, *beg2);
+			copy_buffers(beg1, it, begout);
+			beg1 = it;
+			if(min_gallop > MERGE_MIN_GALLOP)
+				min_gallop /= 2;
+			continue;
 		}
+		if((uint64_t)distance(beg2, end2) > min_gallop && less_func(*(beg2 + min_gallop), *beg1)) {
+			Itr1 it;
+			exponential_search(beg2 + (min_gallop + 1), end2, *beg1, it);
+			copy_buffers(beg2, it, begout);
+			beg2 = it;
+			if(min_gallop > MERGE_MIN_GALLOP)
+				min_gallop /= 2;
+			continue;
+		}
+
+		//otherwise merge item by item until one of the lists has moved min_gallop items, then check again
+		//galloping didn't pay off here, make it harder to start
+		Itr1 lim1 = ((uint64_t)distance(beg1, end1) > min_gallop ? beg1 + min_gallop : end1);
+		Itr1 lim2 = ((uint64_t)distance(beg2, end2) > min_gallop ? beg2 + min_gallop : end2);
+		for(; beg1 != lim1 && beg2 != lim2; ++begout)
+			if(less_func(*beg2, *beg1)) {
+				construct(*begout, std::move(*beg2));
+				++beg2;
+			} else {
+				construct(*begout, std::move(*beg1));
+				++beg1;
+			}
+		min_gallop *= 2;
+	}
 
 	//finish off copy back of remaining lists (if any)
 	copy_buffers(beg1, end1, begout);
@@ -2813,11 +4007,27 @@ bool merge_sort(Itr beg, Itr end) {
 	}
 	return false;
 }
+template<typename Itr>
+bool merge_sort(Itr beg, Itr end, scratch_arena& arena) {
+	if(distance(beg, end) <= 1)
+		return true;
+	//same as above but the buffer is kept in the arena for the next sort
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::scratch_arena_acquire(arena, distance(beg, end) * sizeof(valueof));
+	if(buf) {
+		stlib_internal::merge_sort_internal(beg, end, buf);
+		return true;
+	}
+	return false;
+}
 namespace stlib_internal {
 template<typename Itr, typename T>
 void out_of_place_insertion_sort(Itr beg, Itr end, T* buf) {
-	if(distance(beg, end) <= 1)
+	if(distance(beg, end) <= 1) {
+		//a single item still needs moving to the output
+		copy_buffers(beg, end, buf);
 		return;
+	}
 
 	//do an insertion sort but copying the array to a different destination
 	T* lsted = buf;
@@ -2832,8 +4042,11 @@ void out_of_place_insertion_sort(Itr beg, Itr end, T* buf) {
 }
 template<typename Itr, typename T>
 void out_of_place_multi_insertion_sort(Itr beg, Itr end, T* buf) {
-	if(distance(beg, end) <= 1)
+	if(distance(beg, end) <= 1) {
+		//a single item still needs moving to the output
+		copy_buffers(beg, end, buf);
 		return;
+	}
 
 	//move this to the correct place (do insert)
 	using valueof = typename stlib_internal::value_for<Itr>::value_type;
@@ -2956,71 +4169,311 @@ bool hybrid_merge_sort(Itr beg, Itr end) {
 	}
 	return false;
 }
+template<typename Itr>
+bool hybrid_merge_sort(Itr beg, Itr end, scratch_arena& arena) {
+	if(distance(beg, end) <= 1)
+		return true;
+	//same as above but the buffer is kept in the arena for the next sort
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::scratch_arena_acquire(arena, distance(beg, end) * sizeof(valueof));
+	if(buf) {
+		stlib_internal::hybrid_merge_sort_internal(beg, end, buf);
+		return true;
+	}
+	return false;
+}
 
 
 namespace stlib_internal {
-template<typename Itr>
-void inplace_merge(Itr beg1, Itr beg2, Itr end2) {
-	//backwards inplace merge sort, is more efficient than forwards inplace merge sort
-	Itr left = beg2 - 1;
-	Itr right = end2 - 1;
-	for(; left != beg1 - 1 && right != left; --right) {
-		//get all of those that are greater, move them to the right
-		Itr lft = left;
-		Itr rght = right;
-		for(; lft != beg1 - 1 && greater_func(*lft, *right); --lft, --rght);
-		if(lft != left) {
-			//move those greater left to the right hande side
-			stlib_internal::rotate(lft + 1, left + 1, right + 1);
-			left = lft;
-		}
-		right = rght;
+//maps radix sort keys to unsigned integers that sort in the same order
+template<typename T, bool = std::is_floating_point<T>::value, bool = std::is_signed<T>::value>
+struct radix_key {
+	//unsigned integers are already in order
+	using type = T;
+	static type get(T val) {
+		return val;
 	}
-}
-}
-template<typename Itr>
-void inplace_merge_sort(Itr beg, Itr end) {
+};
+template<typename T>
+struct radix_key<T, false, true> {
+	//signed integers, flip the sign bit so that negative numbers come first
+	using type = typename std::make_unsigned<T>::type;
+	static type get(T val) {
+		return (type)val ^ ((type)1 << (sizeof(type) * 8 - 1));
+	}
+};
+template<typename T>
+struct radix_key<T, true, true> {
+	//IEEE-754, negative numbers flip all of the bits (reversing their order), positive numbers only flip the sign bit
+	using type = typename std::conditional<sizeof(T) == sizeof(uint32_t), uint32_t, uint64_t>::type;
+	static type get(T val) {
+		//-0.0 compares equal to 0.0 so must sort the same to keep this stable
+		if(val == 0)
+			val = 0;
+		type bits;
+		memcpy(&bits, &val, sizeof(bits));
+		const type sign = (type)1 << (sizeof(type) * 8 - 1);
+		return (bits & sign) ? ~bits : (bits | sign);
+	}
+};
+struct radix_identity_key {
+	template<typename T>
+	const T& operator()(const T& val) const {
+		return val;
+	}
+};
+template<typename KeyFunc>
+struct radix_key_less {
+	KeyFunc keyfunc;
+	template<typename T>
+	bool operator()(const T& a, const T& b) const {
+		using keytype = typename std::decay<decltype(keyfunc(a))>::type;
+		return radix_key<keytype>::get(keyfunc(a)) < radix_key<keytype>::get(keyfunc(b));
+	}
+};
+template<typename Itr, typename T, typename KeyFunc>
+void radix_sort_internal(Itr beg, Itr end, T* buf, KeyFunc keyfunc) {
+	using keytype = typename std::decay<decltype(keyfunc(*beg))>::type;
+	using radixtype = typename radix_key<keytype>::type;
+	static_assert(std::is_arithmetic<keytype>::value && sizeof(keytype) <= sizeof(uint64_t),
+				  "radix_sort keys must be integers, float or double");
+	constexpr unsigned passes = sizeof(radixtype);
+
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
 
-	//go through all of the lengths starting at 1 doubling
-	uint64_t len = 1;
-	while(len < sze) {
-		uint64_t pos = 0;
-		//go through all of the sorted sublists, merge them together
-		while(pos + len < sze) {
-			//make the two halves
-			Itr cleft = beg + pos;
-			Itr cright = cleft + len;
-			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
+	//count every digit of every pass up front, one go through the list
+	uint64_t counts[passes][256];
+	memset(counts, 0, sizeof(counts));
+	for(Itr it = beg; it != end; ++it) {
+		radixtype key = radix_key<keytype>::get(keyfunc(*it));
+		for(unsigned pass = 0; pass < passes; ++pass)
+			++counts[pass][(key >> (pass * 8)) & 0xFF];
+	}
+
+	//least significant digit first, each pass is a stable scatter between the list and the buffer
+	radixtype first = radix_key<keytype>::get(keyfunc(*beg));
+	bool in_buffer = false;
+	for(unsigned pass = 0; pass < passes; ++pass) {
+		unsigned shift = pass * 8;
+		//skip this pass if every item has the same digit
+		if(counts[pass][(first >> shift) & 0xFF] == sze)
+			continue;
 
-			//do in-place merge
-			stlib_internal::inplace_merge(cleft, cright, cend);
-			pos += (len * 2);
+		//where each digit starts in the output
+		uint64_t offsets[256];
+		uint64_t total = 0;
+		for(unsigned i = 0; i < 256; ++i) {
+			offsets[i] = total;
+			total += counts[pass][i];
 		}
-		len *= 2;
+
+		if(!in_buffer) {
+			for(Itr it = beg; it != end; ++it) {
+				unsigned digit = (radix_key<keytype>::get(keyfunc(*it)) >> shift) & 0xFF;
+				construct(buf[offsets[digit]++], std::move(*it));
+			}
+		} else {
+			for(T* it = buf; it != buf + sze; ++it) {
+				unsigned digit = (radix_key<keytype>::get(keyfunc(*it)) >> shift) & 0xFF;
+				construct(*(beg + offsets[digit]++), std::move(*it));
+			}
+		}
+		in_buffer = !in_buffer;
+	}
+
+	//ensure we copy this back at the original buffer if needed
+	if(in_buffer) {
+		Itr out = beg;
+		copy_buffers(buf, buf + sze, out);
 	}
 }
-template<typename Itr>
-void hybrid_inplace_merge_sort(Itr beg, Itr end) {
+}
+template<typename Itr, typename KeyFunc>
+bool radix_sort(Itr beg, Itr end, KeyFunc keyfunc) {
 	uint64_t sze = distance(beg, end);
-	if(sze <= 1)
-		return;
-	//sort small runs with insertion sort before doing merge
-	uint64_t insert_count = INSERTION_SORT_CUTOFF;
-	{
-		uint64_t len = insert_count;
-		uint64_t count = 0;
-		for(Itr bg = beg; bg != end; count+=len) {
-			Itr ed = (count + len > sze ? end : bg + len);
-			multi_insertion_sort(bg, ed);
-			bg = ed;
-		}
+	if(sze <= INSERTION_SORT_CUTOFF) {
+		//not worth the counting, this is stable too
+		stlib_internal::radix_key_less<KeyFunc> cmp = {keyfunc};
+		multi_insertion_sort(beg, end, cmp);
+		return true;
 	}
-	if(sze <= insert_count)
-		return;
-
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::aligned_storage_new(sze * sizeof(valueof));
+	if(buf) {
+		stlib_internal::radix_sort_internal(beg, end, buf, keyfunc);
+
+		stlib_internal::aligned_storage_delete(sze * sizeof(valueof), buf);
+		return true;
+	}
+	return false;
+}
+template<typename Itr, typename KeyFunc>
+bool radix_sort(Itr beg, Itr end, KeyFunc keyfunc, scratch_arena& arena) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= INSERTION_SORT_CUTOFF) {
+		stlib_internal::radix_key_less<KeyFunc> cmp = {keyfunc};
+		multi_insertion_sort(beg, end, cmp);
+		return true;
+	}
+	//same as above but the buffer is kept in the arena for the next sort
+	using valueof = typename stlib::stlib_internal::value_for<Itr>::value_type;
+	valueof* buf = (valueof*)stlib_internal::scratch_arena_acquire(arena, sze * sizeof(valueof));
+	if(buf) {
+		stlib_internal::radix_sort_internal(beg, end, buf, keyfunc);
+		return true;
+	}
+	return false;
+}
+template<typename Itr>
+bool radix_sort(Itr beg, Itr end) {
+	return radix_sort(beg, end, stlib_internal::radix_identity_key());
+}
+template<typename Itr>
+bool radix_sort(Itr beg, Itr end, scratch_arena& arena) {
+	return radix_sort(beg, end, stlib_internal::radix_identity_key(), arena);
+}
+
+
+namespace stlib_internal {
+template<typename Itr, typename KeyFunc>
+void american_flag_sort_internal(Itr beg, Itr end, KeyFunc keyfunc, unsigned shift) {
+	using keytype = typename std::decay<decltype(keyfunc(*beg))>::type;
+	for(;;) {
+		uint64_t sze = distance(beg, end);
+		if(sze <= AMERICAN_FLAG_SORT_CUTOFF) {
+			radix_key_less<KeyFunc> cmp = {keyfunc};
+			multi_insertion_sort(beg, end, cmp);
+			return;
+		}
+
+		//count how many items go in each bucket
+		uint64_t next[256];
+		uint64_t ends[256];
+		memset(ends, 0, sizeof(ends));
+		for(Itr it = beg; it != end; ++it)
+			++ends[(radix_key<keytype>::get(keyfunc(*it)) >> shift) & 0xFF];
+
+		//if every item has the same digit move straight on to the next digit
+		if(ends[(radix_key<keytype>::get(keyfunc(*beg)) >> shift) & 0xFF] == sze) {
+			if(shift == 0)
+				return;
+			shift -= 8;
+			continue;
+		}
+
+		//where each bucket starts and ends
+		uint64_t total = 0;
+		for(unsigned i = 0; i < 256; ++i) {
+			next[i] = total;
+			total += ends[i];
+			ends[i] = total;
+		}
+
+		//swap every item directly into the next free place in its bucket
+		for(unsigned bucket = 0; bucket < 256; ++bucket)
+			while(next[bucket] < ends[bucket]) {
+				Itr it = beg + next[bucket];
+				unsigned digit = (radix_key<keytype>::get(keyfunc(*it)) >> shift) & 0xFF;
+				if(digit == bucket)
+					++next[bucket];
+				else
+					std::swap(*it, *(beg + next[digit]++));
+			}
+		if(shift == 0)
+			return;
+
+		//sort each bucket on the next digit
+		uint64_t pos = 0;
+		for(unsigned bucket = 0; bucket < 256; ++bucket) {
+			if(ends[bucket] - pos > 1)
+				american_flag_sort_internal(beg + pos, beg + ends[bucket], keyfunc, shift - 8);
+			pos = ends[bucket];
+		}
+		return;
+	}
+}
+}
+template<typename Itr, typename KeyFunc>
+void american_flag_sort(Itr beg, Itr end, KeyFunc keyfunc) {
+	using keytype = typename std::decay<decltype(keyfunc(*beg))>::type;
+	static_assert(std::is_arithmetic<keytype>::value && sizeof(keytype) <= sizeof(uint64_t),
+				  "american_flag_sort keys must be integers, float or double");
+	if(distance(beg, end) <= 1)
+		return;
+	//most significant digit first
+	stlib_internal::american_flag_sort_internal(beg, end, keyfunc, (sizeof(typename stlib_internal::radix_key<keytype>::type) - 1) * 8);
+}
+template<typename Itr>
+void american_flag_sort(Itr beg, Itr end) {
+	american_flag_sort(beg, end, stlib_internal::radix_identity_key());
+}
+
+
+namespace stlib_internal {
+template<typename Itr>
+void inplace_merge(Itr beg1, Itr beg2, Itr end2) {
+	//backwards inplace merge sort, is more efficient than forwards inplace merge sort
+	Itr left = beg2 - 1;
+	Itr right = end2 - 1;
+	for(; left != beg1 - 1 && right != left; --right) {
+		//get all of those that are greater, move them to the right
+		Itr lft = left;
+		Itr rght = right;
+		for(; lft != beg1 - 1 && greater_func(*lft, *right); --lft, --rght);
+		if(lft != left) {
+			//move those greater left to the right hande side
+			stlib_internal::rotate(lft + 1, left + 1, right + 1);
+			left = lft;
+		}
+		right = rght;
+	}
+}
+}
+template<typename Itr>
+void inplace_merge_sort(Itr beg, Itr end) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+
+	//go through all of the lengths starting at 1 doubling
+	uint64_t len = 1;
+	while(len < sze) {
+		uint64_t pos = 0;
+		//go through all of the sorted sublists, merge them together
+		while(pos + len < sze) {
+			//make the two halves
+			Itr cleft = beg + pos;
+			Itr cright = cleft + len;
+			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
+
+			//do in-place merge
+			stlib_internal::inplace_merge(cleft, cright, cend);
+			pos += (len * 2);
+		}
+		len *= 2;
+	}
+}
+template<typename Itr>
+void hybrid_inplace_merge_sort(Itr beg, Itr end) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+	//sort small runs with insertion sort before doing merge
+	uint64_t insert_count = INSERTION_SORT_CUTOFF;
+	{
+		uint64_t len = insert_count;
+		uint64_t count = 0;
+		for(Itr bg = beg; bg != end; count+=len) {
+			Itr ed = (count + len > sze ? end : bg + len);
+			multi_insertion_sort(bg, ed);
+			bg = ed;
+		}
+	}
+	if(sze <= insert_count)
+		return;
+
 	//go through all of the lengths starting at 1 doubling
 	uint64_t len = insert_count;
 	while(len < sze) {
@@ -3132,7 +4585,7 @@ void inner_rotate_merge(Itr beg1, Itr beg2, Itr end2, Itr& out) {
 
 	//search through the right for the position of the first from the left hand side
 	Itr tmp;
-	bool found = binary_search(beg2, end2, *beg1, tmp);
+	bool found = exponential_search(beg2, end2, *beg1, tmp);
 	if(found) {
 		//if we are moving in an equal item, move to the left while we are looking at equal items (ensures stable ordering)
 		--tmp;
@@ -3165,10 +4618,20 @@ void inner_rotate_merge(Itr beg1, Itr beg2, Itr end2, Itr& out) {
 }
 template<typename Itr>
 void rotate_merge(Itr beg1, Itr beg2, Itr end2) {
+	if(beg1 == beg2 || beg2 == end2)
+		return;
+	//already in order, nothing to do (common when merging mostly sorted runs)
+	if(!less_func(*beg2, *(beg2 - 1)))
+		return;
+	//the left items not greater than the first right item are already in place, as are the right items not less than the last left item
+	//gallop to find these and only merge what is left
+	beg1 = exponential_search_upper(beg1, beg2, *beg2);
+	Itr tmp;
+	exponential_search(beg2, end2, *(beg2 - 1), tmp);
+	end2 = tmp;
+
 	//half the left, do this before doing rotate merge (reduces initial rotate cost considerably)
 	uint64_t sze = distance(beg1, beg2);
-	if(sze == 0)
-		return;
 
 	Itr nout_1 = end2;
 	while(sze > 0) {
@@ -3179,9 +4642,129 @@ void rotate_merge(Itr beg1, Itr beg2, Itr end2) {
 		sze /= 2;
 	}
 }
+template<typename Itr>
+void sym_merge(Itr beg1, Itr beg2, Itr end2) {
+	uint64_t sze1 = distance(beg1, beg2);
+	uint64_t sze2 = distance(beg2, end2);
+	if(sze1 == 0 || sze2 == 0 || !less_func(*beg2, *(beg2 - 1)))
+		return;
+	if(sze1 == 1) {
+		//put the one left item before the first right item not less than it
+		Itr pos;
+		stlib::binary_search(beg2, end2, *beg1, pos);
+		stlib_internal::rotate(beg1, beg2, pos);
+		return;
+	}
+	if(sze2 == 1) {
+		//put the one right item after the last left item not greater than it
+		Itr pos = exponential_search_upper(beg1, beg2, *beg2);
+		stlib_internal::rotate(pos, beg2, end2);
+		return;
+	}
+	//find the split of the two runs symmetric around the middle of the whole range, rotate the two inner parts
+	//into place around the middle and merge each side
+	uint64_t mid = (sze1 + sze2) / 2;
+	uint64_t n = mid + sze1;
+	uint64_t start = (sze1 > mid ? n - (sze1 + sze2) : 0);
+	uint64_t r = (sze1 > mid ? mid : sze1);
+	while(start < r) {
+		uint64_t c = (start + r) / 2;
+		if(!less_func(*(beg1 + (n - 1 - c)), *(beg1 + c)))
+			start = c + 1;
+		else
+			r = c;
+	}
+	uint64_t end = n - start;
+	if(start < sze1 && sze1 < end)
+		stlib_internal::rotate(beg1 + start, beg2, beg1 + end);
+	if(0 < start && start < mid)
+		sym_merge(beg1, beg1 + start, beg1 + mid);
+	if(mid < end && end < sze1 + sze2)
+		sym_merge(beg1 + mid, beg1 + end, end2);
+}
+template<typename Itr>
+void binary_merge(Itr beg1, Itr beg2, Itr end2) {
+	//each step places the outer item of the shorter run, it is found in the longer run by stepping over blocks of
+	//(longer / shorter) items and then a binary search of one block (Hwang and Lin), the items of the longer run that
+	//belong on the other side of it are rotated past the whole shorter run, this does O(m^2 + n) moves
+	while(beg1 != beg2 && beg2 != end2) {
+		uint64_t sze1 = distance(beg1, beg2);
+		uint64_t sze2 = distance(beg2, end2);
+		if(sze1 * sze1 > sze2 && sze2 * sze2 > sze1) {
+			//the runs are close in size, placing one item at a time would rotate most of the longer run each step,
+			//split around the middle of the longer run until one side is no more than the square root of the other
+			Itr mid;
+			Itr pos;
+			if(sze1 >= sze2) {
+				//the right items less than the middle left item go before it
+				mid = beg1 + (sze1 / 2);
+				stlib::binary_search(beg2, end2, *mid, pos);
+				stlib_internal::rotate(mid, beg2, pos);
+				binary_merge(beg1, mid, mid + distance(beg2, pos));
+				beg1 = mid + distance(beg2, pos);
+				beg2 = beg1 + distance(mid, beg2);
+			} else {
+				//the left items greater than the middle right item go after it
+				mid = beg2 + (sze2 / 2);
+				pos = exponential_search_upper(beg1, beg2, *mid);
+				stlib_internal::rotate(pos, beg2, mid);
+				binary_merge(beg1, pos, pos + distance(beg2, mid));
+				beg1 = pos + distance(beg2, mid);
+				beg2 = mid;
+			}
+			continue;
+		}
+		if(sze1 <= sze2) {
+			//place the first left item, the right items less than it are rotated in front of the whole left run and are then in place
+			uint64_t step = hwang_lin_step(sze2, sze1);
+			Itr lo = beg2;
+			while((uint64_t)distance(lo, end2) > step && less_func(*(lo + (step - 1)), *beg1))
+				lo += step;
+			Itr pos;
+			stlib::binary_search(lo, ((uint64_t)distance(lo, end2) > step ? lo + step : end2), *beg1, pos);
+			stlib_internal::rotate(beg1, beg2, pos);
+			beg1 += distance(beg2, pos);
+			beg2 = pos;
+			//the left items not greater than the next right item are also in place
+			if(beg2 != end2)
+				beg1 = exponential_search_upper(beg1, beg2, *beg2);
+		} else {
+			//place the last right item, the left items greater than it are rotated after the whole right run and are then in place
+			uint64_t step = hwang_lin_step(sze1, sze2);
+			Itr hi = beg2;
+			while((uint64_t)distance(beg1, hi) > step && less_func(*(end2 - 1), *(hi - step)))
+				hi -= step;
+			Itr pos = exponential_search_upper(((uint64_t)distance(beg1, hi) > step ? hi - step : beg1), hi, *(end2 - 1));
+			stlib_internal::rotate(pos, beg2, end2);
+			end2 = pos + sze2;
+			beg2 = pos;
+			//the right items not less than the previous left item are also in place
+			if(beg1 != beg2) {
+				Itr rgt;
+				stlib::binary_search(beg2, end2, *(beg2 - 1), rgt);
+				end2 = rgt;
+			}
+		}
+	}
+}
+template<typename Itr>
+void rotate_merge_sort_do_merge(Itr beg1, Itr beg2, Itr end2, NEW_ZIP_MERGE_KIND kind) {
+	//only the constant memory merges that don't need a buffer, the other kinds use rotate_merge
+	switch(kind) {
+	case NEW_ZIP_MERGE_KIND::NZMK_SYM_MERGE:
+		sym_merge(beg1, beg2, end2);
+		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_BINARY_MERGE:
+		binary_merge(beg1, beg2, end2);
+		break;
+	default:
+		rotate_merge(beg1, beg2, end2);
+		break;
+	}
+}
 }
 template<typename Itr>
-void rotate_merge_sort(Itr beg, Itr end) {
+void rotate_merge_sort(Itr beg, Itr end, NEW_ZIP_MERGE_KIND kind) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
@@ -3198,25 +4781,25 @@ void rotate_merge_sort(Itr beg, Itr end) {
 			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
 
 			//do rotate merge
-			stlib_internal::rotate_merge(cleft, cright, cend);
+			stlib_internal::rotate_merge_sort_do_merge(cleft, cright, cend, kind);
 			pos += (len * 2);
 		}
 		len *= 2;
 	}
 }
 template<typename Itr>
-void hybrid_rotate_merge_sort(Itr beg, Itr end) {
+void hybrid_rotate_merge_sort(Itr beg, Itr end, NEW_ZIP_MERGE_KIND kind = NEW_ZIP_MERGE_KIND::NZMK_ROTATE_MERGE, SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
-	//sort small runs with insertion sort before doing merge
+	//sort small runs with insertion sort (or the chosen small sort) before doing merge
 	uint64_t insert_count = INSERTION_SORT_CUTOFF;
 	{
 		uint64_t len = insert_count;
 		uint64_t count = 0;
 		for(Itr bg = beg; bg != end; count+=len) {
 			Itr ed = (count + len > sze ? end : bg + len);
-			multi_insertion_sort(bg, ed);
+			stlib_internal::small_sort(bg, ed, small);
 			bg = ed;
 		}
 	}
@@ -3235,7 +4818,7 @@ void hybrid_rotate_merge_sort(Itr beg, Itr end) {
 			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
 
 			//do rotate merge
-			stlib_internal::rotate_merge(cleft, cright, cend);
+			stlib_internal::rotate_merge_sort_do_merge(cleft, cright, cend, kind);
 			pos += (len * 2);
 		}
 		len *= 2;
@@ -3251,7 +4834,7 @@ void inner_rotate_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp, Itr& out) {
 
 	//search through the right for the position of the first from the left hand side
 	Itr tmp;
-	bool found = binary_search(beg2, end2, *beg1, cmp, tmp);
+	bool found = exponential_search(beg2, end2, *beg1, cmp, tmp);
 	if(found) {
 		//if we are moving in an equal item, move to the left while we are looking at equal items (ensures stable ordering)
 		--tmp;
@@ -3284,10 +4867,20 @@ void inner_rotate_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp, Itr& out) {
 }
 template<typename Itr, typename Comp>
 void rotate_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp) {
+	if(beg1 == beg2 || beg2 == end2)
+		return;
+	//already in order, nothing to do (common when merging mostly sorted runs)
+	if(!less_func(*beg2, *(beg2 - 1), cmp))
+		return;
+	//the left items not greater than the first right item are already in place, as are the right items not less than the last left item
+	//gallop to find these and only merge what is left
+	beg1 = exponential_search_upper(beg1, beg2, *beg2, cmp);
+	Itr tmp;
+	exponential_search(beg2, end2, *(beg2 - 1), cmp, tmp);
+	end2 = tmp;
+
 	//half the left, do this before doing rotate merge (reduces initial rotate cost considerably)
 	uint64_t sze = distance(beg1, beg2);
-	if(sze == 0)
-		return;
 
 	Itr nout_1 = end2;
 	while(sze > 0) {
@@ -3298,9 +4891,129 @@ void rotate_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp) {
 		sze /= 2;
 	}
 }
+template<typename Itr, typename Comp>
+void sym_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp) {
+	uint64_t sze1 = distance(beg1, beg2);
+	uint64_t sze2 = distance(beg2, end2);
+	if(sze1 == 0 || sze2 == 0 || !less_func(*beg2, *(beg2 - 1), cmp))
+		return;
+	if(sze1 == 1) {
+		//put the one left item before the first right item not less than it
+		Itr pos;
+		stlib::binary_search(beg2, end2, *beg1, cmp, pos);
+		stlib_internal::rotate(beg1, beg2, pos);
+		return;
+	}
+	if(sze2 == 1) {
+		//put the one right item after the last left item not greater than it
+		Itr pos = exponential_search_upper(beg1, beg2, *beg2, cmp);
+		stlib_internal::rotate(pos, beg2, end2);
+		return;
+	}
+	//find the split of the two runs symmetric around the middle of the whole range, rotate the two inner parts
+	//into place around the middle and merge each side
+	uint64_t mid = (sze1 + sze2) / 2;
+	uint64_t n = mid + sze1;
+	uint64_t start = (sze1 > mid ? n - (sze1 + sze2) : 0);
+	uint64_t r = (sze1 > mid ? mid : sze1);
+	while(start < r) {
+		uint64_t c = (start + r) / 2;
+		if(!less_func(*(beg1 + (n - 1 - c)), *(beg1 + c), cmp))
+			start = c + 1;
+		else
+			r = c;
+	}
+	uint64_t end = n - start;
+	if(start < sze1 && sze1 < end)
+		stlib_internal::rotate(beg1 + start, beg2, beg1 + end);
+	if(0 < start && start < mid)
+		sym_merge(beg1, beg1 + start, beg1 + mid, cmp);
+	if(mid < end && end < sze1 + sze2)
+		sym_merge(beg1 + mid, beg1 + end, end2, cmp);
+}
+template<typename Itr, typename Comp>
+void binary_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp) {
+	//each step places the outer item of the shorter run, it is found in the longer run by stepping over blocks of
+	//(longer / shorter) items and then a binary search of one block (Hwang and Lin), the items of the longer run that
+	//belong on the other side of it are rotated past the whole shorter run, this does O(m^2 + n) moves
+	while(beg1 != beg2 && beg2 != end2) {
+		uint64_t sze1 = distance(beg1, beg2);
+		uint64_t sze2 = distance(beg2, end2);
+		if(sze1 * sze1 > sze2 && sze2 * sze2 > sze1) {
+			//the runs are close in size, placing one item at a time would rotate most of the longer run each step,
+			//split around the middle of the longer run until one side is no more than the square root of the other
+			Itr mid;
+			Itr pos;
+			if(sze1 >= sze2) {
+				//the right items less than the middle left item go before it
+				mid = beg1 + (sze1 / 2);
+				stlib::binary_search(beg2, end2, *mid, cmp, pos);
+				stlib_internal::rotate(mid, beg2, pos);
+				binary_merge(beg1, mid, mid + distance(beg2, pos), cmp);
+				beg1 = mid + distance(beg2, pos);
+				beg2 = beg1 + distance(mid, beg2);
+			} else {
+				//the left items greater than the middle right item go after it
+				mid = beg2 + (sze2 / 2);
+				pos = exponential_search_upper(beg1, beg2, *mid, cmp);
+				stlib_internal::rotate(pos, beg2, mid);
+				binary_merge(beg1, pos, pos + distance(beg2, mid), cmp);
+				beg1 = pos + distance(beg2, mid);
+				beg2 = mid;
+			}
+			continue;
+		}
+		if(sze1 <= sze2) {
+			//place the first left item, the right items less than it are rotated in front of the whole left run and are then in place
+			uint64_t step = hwang_lin_step(sze2, sze1);
+			Itr lo = beg2;
+			while((uint64_t)distance(lo, end2) > step && less_func(*(lo + (step - 1)), *beg1, cmp))
+				lo += step;
+			Itr pos;
+			stlib::binary_search(lo, ((uint64_t)distance(lo, end2) > step ? lo + step : end2), *beg1, cmp, pos);
+			stlib_internal::rotate(beg1, beg2, pos);
+			beg1 += distance(beg2, pos);
+			beg2 = pos;
+			//the left items not greater than the next right item are also in place
+			if(beg2 != end2)
+				beg1 = exponential_search_upper(beg1, beg2, *beg2, cmp);
+		} else {
+			//place the last right item, the left items greater than it are rotated after the whole right run and are then in place
+			uint64_t step = hwang_lin_step(sze1, sze2);
+			Itr hi = beg2;
+			while((uint64_t)distance(beg1, hi) > step && less_func(*(end2 - 1), *(hi - step), cmp))
+				hi -= step;
+			Itr pos = exponential_search_upper(((uint64_t)distance(beg1, hi) > step ? hi - step : beg1), hi, *(end2 - 1), cmp);
+			stlib_internal::rotate(pos, beg2, end2);
+			end2 = pos + sze2;
+			beg2 = pos;
+			//the right items not less than the previous left item are also in place
+			if(beg1 != beg2) {
+				Itr rgt;
+				stlib::binary_search(beg2, end2, *(beg2 - 1), cmp, rgt);
+				end2 = rgt;
+			}
+		}
+	}
+}
+template<typename Itr, typename Comp>
+void rotate_merge_sort_do_merge(Itr beg1, Itr beg2, Itr end2, Comp cmp, NEW_ZIP_MERGE_KIND kind) {
+	//only the constant memory merges that don't need a buffer, the other kinds use rotate_merge
+	switch(kind) {
+	case NEW_ZIP_MERGE_KIND::NZMK_SYM_MERGE:
+		sym_merge(beg1, beg2, end2, cmp);
+		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_BINARY_MERGE:
+		binary_merge(beg1, beg2, end2, cmp);
+		break;
+	default:
+		rotate_merge(beg1, beg2, end2, cmp);
+		break;
+	}
+}
 }
 template<typename Itr, typename Comp>
-void rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
+void rotate_merge_sort(Itr beg, Itr end, Comp cmp, NEW_ZIP_MERGE_KIND kind) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
@@ -3317,25 +5030,25 @@ void rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
 			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
 
 			//do rotate merge
-			stlib_internal::rotate_merge(cleft, cright, cend, cmp);
+			stlib_internal::rotate_merge_sort_do_merge(cleft, cright, cend, cmp, kind);
 			pos += (len * 2);
 		}
 		len *= 2;
 	}
 }
 template<typename Itr, typename Comp>
-void hybrid_rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
+void hybrid_rotate_merge_sort(Itr beg, Itr end, Comp cmp, NEW_ZIP_MERGE_KIND kind = NEW_ZIP_MERGE_KIND::NZMK_ROTATE_MERGE, SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
-	//sort small runs with insertion sort before doing merge
+	//sort small runs with insertion sort (or the chosen small sort) before doing merge
 	uint64_t insert_count = INSERTION_SORT_CUTOFF;
 	{
 		uint64_t len = insert_count;
 		uint64_t count = 0;
 		for(Itr bg = beg; bg != end; count+=len) {
 			Itr ed = (count + len > sze ? end : bg + len);
-			multi_insertion_sort(bg, ed, cmp);
+			stlib_internal::small_sort(bg, ed, cmp, small);
 			bg = ed;
 		}
 	}
@@ -3354,7 +5067,7 @@ void hybrid_rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
 			Itr cend = (pos + (len * 2) > sze ? end : cleft + (len * 2));
 
 			//do rotate merge
-			stlib_internal::rotate_merge(cleft, cright, cend, cmp);
+			stlib_internal::rotate_merge_sort_do_merge(cleft, cright, cend, cmp, kind);
 			pos += (len * 2);
 		}
 		len *= 2;
@@ -3362,8 +5075,17 @@ void hybrid_rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
 }
 
 
+enum class STACKLESS_MERGE_KIND : uint8_t {
+	//merge neighbouring runs once they are of similar size (7/8), collapse by merging the closest in size
+	SMK_SIZE_RATIO,
+	//powersort, merge by the node power of the run boundaries, near optimal merge cost for any pattern of run lengths
+	SMK_POWERSORT
+};
 namespace stlib_internal {
 constexpr unsigned stackless_rotate_range_array_len = 24;
+//node powers are unique on the stack and at most 64, plus the two runs being considered
+constexpr unsigned stackless_powersort_range_array_len = 66;
+unsigned powersort_node_power(uint64_t beg1, uint64_t len1, uint64_t len2, uint64_t sze);
 template<typename Itr>
 struct stackless_range {
 	Itr bg;
@@ -3461,14 +5183,14 @@ void do_stackless_rotate_identify(stackless_range<Itr>* stk, Itr beg, Itr end, u
 
 	//do reverse of this if we are not a
 	if(!ascending) {
-		reverse(rslt.bg, rslt.ed);
+		stlib_internal::reverse(rslt.bg, rslt.ed);
 		//to ensure stable ordering we must reverse again on any equal elements
 		if(some_equal) {
 			//go through them re-reverse any that we need
 			stackless_range<Itr> strt = rslt;
 			while(strt.bg != strt.ed) {
 				Itr it = equal_run(strt.bg, strt.ed);
-				reverse(it, strt.bg);
+				stlib_internal::reverse(it, strt.bg);
 			}
 		}
 	}
@@ -3509,10 +5231,43 @@ void stackless_rotate_merge_sort_internal(Itr beg, Itr end) {
 			bg = stk[stack_pos - 1].ed;
 		}
 }
+template<typename Itr>
+void stackless_rotate_powersort_internal(Itr beg, Itr end) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+
+	//runs still to be merged, pwr[i] is the node power of the boundary between stk[i] and stk[i + 1]
+	//the powers are strictly increasing down the stack so this never needs more than 66 entries
+	stackless_range<Itr> stk[stackless_powersort_range_array_len];
+	unsigned pwr[stackless_powersort_range_array_len];
+	unsigned stack_pos = 0;
+	do_stackless_rotate_identify(stk, beg, end, stack_pos);
+	while(stk[stack_pos - 1].ed != end) {
+		//identify the next run, it sits above the current run
+		do_stackless_rotate_identify(stk, stk[stack_pos - 1].ed, end, stack_pos);
+		const stackless_range<Itr>& first = stk[stack_pos - 2];
+		const stackless_range<Itr>& second = stk[stack_pos - 1];
+		unsigned power = powersort_node_power(distance(beg, first.bg), distance(first.bg, first.ed),
+											  distance(second.bg, second.ed), sze);
+
+		//merge everything below the current run that has a greater power than the new boundary
+		while(stack_pos > 2 && pwr[stack_pos - 3] > power)
+			do_stackless_rotate_merge(stk, stk[stack_pos - 3], stk[stack_pos - 2], stack_pos - 3, stack_pos);
+		pwr[stack_pos - 2] = power;
+	}
+
+	//merge what is left, from the top down
+	while(stack_pos > 1)
+		do_stackless_rotate_merge(stk, stk[stack_pos - 2], stk[stack_pos - 1], stack_pos - 2, stack_pos);
+}
 }
 template<typename Itr>
-void stackless_rotate_merge_sort(Itr beg, Itr end) {
-	stlib_internal::stackless_rotate_merge_sort_internal(beg, end);
+void stackless_rotate_merge_sort(Itr beg, Itr end, STACKLESS_MERGE_KIND kind = STACKLESS_MERGE_KIND::SMK_SIZE_RATIO) {
+	if(kind == STACKLESS_MERGE_KIND::SMK_POWERSORT)
+		stlib_internal::stackless_rotate_powersort_internal(beg, end);
+	else
+		stlib_internal::stackless_rotate_merge_sort_internal(beg, end);
 }
 
 namespace stlib_internal {
@@ -3589,14 +5344,14 @@ void do_stackless_rotate_identify(stackless_range<Itr>* stk, Itr beg, Itr end, u
 
 	//do reverse of this if we are not a
 	if(!ascending) {
-		reverse(rslt.bg, rslt.ed);
+		stlib_internal::reverse(rslt.bg, rslt.ed);
 		//to ensure stable ordering we must reverse again on any equal elements
 		if(some_equal) {
 			//go through them re-reverse any that we need
 			stackless_range<Itr> strt = rslt;
 			while(strt.bg != strt.ed) {
 				Itr it = equal_run(strt.bg, strt.ed, cmp);
-				reverse(it, strt.bg);
+				stlib_internal::reverse(it, strt.bg);
 			}
 		}
 	}
@@ -3637,10 +5392,43 @@ void stackless_rotate_merge_sort_internal(Itr beg, Itr end, Comp cmp) {
 			bg = stk[stack_pos - 1].ed;
 		}
 }
+template<typename Itr, typename Comp>
+void stackless_rotate_powersort_internal(Itr beg, Itr end, Comp cmp) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+
+	//runs still to be merged, pwr[i] is the node power of the boundary between stk[i] and stk[i + 1]
+	//the powers are strictly increasing down the stack so this never needs more than 66 entries
+	stackless_range<Itr> stk[stackless_powersort_range_array_len];
+	unsigned pwr[stackless_powersort_range_array_len];
+	unsigned stack_pos = 0;
+	do_stackless_rotate_identify(stk, beg, end, stack_pos, cmp);
+	while(stk[stack_pos - 1].ed != end) {
+		//identify the next run, it sits above the current run
+		do_stackless_rotate_identify(stk, stk[stack_pos - 1].ed, end, stack_pos, cmp);
+		const stackless_range<Itr>& first = stk[stack_pos - 2];
+		const stackless_range<Itr>& second = stk[stack_pos - 1];
+		unsigned power = powersort_node_power(distance(beg, first.bg), distance(first.bg, first.ed),
+											  distance(second.bg, second.ed), sze);
+
+		//merge everything below the current run that has a greater power than the new boundary
+		while(stack_pos > 2 && pwr[stack_pos - 3] > power)
+			do_stackless_rotate_merge(stk, stk[stack_pos - 3], stk[stack_pos - 2], stack_pos - 3, stack_pos, cmp);
+		pwr[stack_pos - 2] = power;
+	}
+
+	//merge what is left, from the top down
+	while(stack_pos > 1)
+		do_stackless_rotate_merge(stk, stk[stack_pos - 2], stk[stack_pos - 1], stack_pos - 2, stack_pos, cmp);
+}
 }
 template<typename Itr, typename Comp>
-void stackless_rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
-	stlib_internal::stackless_rotate_merge_sort_internal(beg, end, cmp);
+void stackless_rotate_merge_sort(Itr beg, Itr end, Comp cmp, STACKLESS_MERGE_KIND kind = STACKLESS_MERGE_KIND::SMK_SIZE_RATIO) {
+	if(kind == STACKLESS_MERGE_KIND::SMK_POWERSORT)
+		stlib_internal::stackless_rotate_powersort_internal(beg, end, cmp);
+	else
+		stlib_internal::stackless_rotate_merge_sort_internal(beg, end, cmp);
 }
 
 
@@ -3664,18 +5452,18 @@ uint64_t get_last_size(Itr beg, Itr cbeg, uint64_t block_count) {
 	return last_count;
 }
 template<typename Itr>
-void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end) {
+void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end, SMALL_SORT_KIND small) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
-	//sort small runs with insertion sort before doing merge
+	//sort small runs with insertion sort (or the chosen small sort) before doing merge
 	uint64_t insert_count = INSERTION_SORT_CUTOFF;
 	{
 		uint64_t len = insert_count;
 		uint64_t count = 0;
 		for(Itr bg = beg; bg != end; count+=len) {
 			Itr ed = (count + len > sze ? end : bg + len);
-			multi_insertion_sort(bg, ed);
+			stlib_internal::small_sort(bg, ed, small);
 			bg = ed;
 		}
 	}
@@ -3720,24 +5508,24 @@ void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end) {
 }
 }
 template<typename Itr>
-void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end) {
-	stlib_internal::hybrid_stackless_rotate_merge_sort_internal(beg, end);
+void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end, SMALL_SORT_KIND small) {
+	stlib_internal::hybrid_stackless_rotate_merge_sort_internal(beg, end, small);
 }
 
 namespace stlib_internal {
 template<typename Itr, typename Comp>
-void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end, Comp cmp) {
+void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end, Comp cmp, SMALL_SORT_KIND small) {
 	uint64_t sze = distance(beg, end);
 	if(sze <= 1)
 		return;
-	//sort small runs with insertion sort before doing merge
+	//sort small runs with insertion sort (or the chosen small sort) before doing merge
 	uint64_t insert_count = INSERTION_SORT_CUTOFF;
 	{
 		uint64_t len = insert_count;
 		uint64_t count = 0;
 		for(Itr bg = beg; bg != end; count+=len) {
 			Itr ed = (count + len > sze ? end : bg + len);
-			multi_insertion_sort(bg, ed, cmp);
+			stlib_internal::small_sort(bg, ed, cmp, small);
 			bg = ed;
 		}
 	}
@@ -3782,34 +5570,561 @@ void hybrid_stackless_rotate_merge_sort_internal(Itr beg, Itr end, Comp cmp) {
 }
 }
 template<typename Itr, typename Comp>
-void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end, Comp cmp) {
-	stlib_internal::hybrid_stackless_rotate_merge_sort_internal(beg, end, cmp);
+void hybrid_stackless_rotate_merge_sort(Itr beg, Itr end, Comp cmp, SMALL_SORT_KIND small) {
+	stlib_internal::hybrid_stackless_rotate_merge_sort_internal(beg, end, cmp, small);
 }
 
 
-
 namespace stlib_internal {
-//for use with stable intro sort (depth > maxdepth)
-template<typename Itr, typename IdxItr>
-void stable_inner_rotate_merge(Itr strt, Itr beg1, Itr beg2, Itr end2, IdxItr begidx, Itr& out) {
-	//if size == 0 return
-	uint64_t sze = distance(beg1, beg2);
-	if(sze == 0)
+template<typename Itr>
+void block_swap(Itr a, Itr b, uint64_t count) {
+	//swap two blocks of the same size, goes forwards so also works for overlapping blocks when a < b
+	for(; count > 0; --count, ++a, ++b)
+		std::swap(*a, *b);
+}
+template<typename Itr>
+uint64_t block_merge_collect_keys(Itr beg, Itr end, uint64_t needed) {
+	//move the first of each unique item to the front of the list (in sorted order), these are used as the internal buffer and block tags
+	//as they are the first of each item this does not change the order of equal items
+	uint64_t sze = distance(beg, end);
+	uint64_t found = 1;
+	uint64_t keys_pos = 0;
+	for(uint64_t i = 1; i < sze && found < needed; ++i) {
+		Itr keys = beg + keys_pos;
+		Itr pos;
+		if(!binary_search(keys, keys + found, *(beg + i), pos)) {
+			//bring the keys up to this item, then insert it in order
+			uint64_t offset = distance(keys, pos);
+			stlib_internal::rotate(keys, keys + found, beg + i);
+			keys_pos = i - found;
+			keys = beg + keys_pos;
+			stlib_internal::rotate(keys + offset, beg + i, beg + i + 1);
+			++found;
+		}
+	}
+	//move the keys to the front
+	stlib_internal::rotate(beg, beg + keys_pos, beg + keys_pos + found);
+	return found;
+}
+template<typename Itr>
+void block_merge_buffered(Itr beg1, Itr beg2, Itr end2, Itr buf) {
+	//merge two neighbouring lists, swapping the left list out into the buffer first (left list must fit in the buffer)
+	//the buffer items end up back in the buffer (in a different order)
+	if(!less_func(*beg2, *(beg2 - 1)))
+		return;
+	Itr left = buf;
+	Itr left_end = buf + distance(beg1, beg2);
+	block_swap(beg1, buf, distance(beg1, beg2));
+	Itr out = beg1;
+	for(; left != left_end && beg2 != end2; ++out)
+		if(less_func(*beg2, *left)) {
+			std::swap(*out, *beg2);
+			++beg2;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	//whatever is left of the right list is already in place
+	block_swap(out, left, distance(left, left_end));
+}
+template<typename Itr>
+void block_merge_left(Itr beg, uint64_t len1, uint64_t len2, uint64_t block_len) {
+	//merge two neighbouring lists into the buffer directly before beg, the right list must be no larger than the buffer
+	Itr out = beg - block_len;
+	Itr left = beg;
+	Itr left_end = beg + len1;
+	Itr right = left_end;
+	Itr right_end = right + len2;
+	for(; right != right_end; ++out)
+		if(left == left_end || less_func(*right, *left)) {
+			std::swap(*out, *right);
+			++right;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	//move the rest of the left list down
+	if(out != left)
+		block_swap(out, left, distance(left, left_end));
+}
+template<typename Itr>
+void block_merge_smart(Itr beg, uint64_t& len1, bool& from_right, uint64_t len2, uint64_t block_len) {
+	//merge the remainder of the last block with the next block (from the other list) into the buffer directly before beg
+	//what is left over becomes the new remainder, this may be from either list
+	Itr out = beg - block_len;
+	Itr left = beg;
+	Itr left_end = beg + len1;
+	Itr right = left_end;
+	Itr right_end = right + len2;
+	for(; left != left_end && right != right_end; ++out)
+		//equal items from the left list go first, unless the remainder came from the right list
+		if(from_right ? !less_func(*left, *right) : less_func(*right, *left)) {
+			std::swap(*out, *right);
+			++right;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	if(left != left_end) {
+		//move the rest of the remainder to the end, after the buffer
+		len1 = distance(left, left_end);
+		while(left != left_end)
+			std::swap(*--left_end, *--right_end);
+	} else {
+		//the rest of the block is in place and is the new remainder
+		len1 = distance(right, right_end);
+		from_right = !from_right;
+	}
+}
+template<typename Itr>
+void block_merge_blocks(Itr keys, Itr midkey, Itr beg, uint64_t block_count, uint64_t block_len,
+						uint64_t last_blocks, uint64_t last_len) {
+	//merge the sorted blocks into the buffer directly before beg, the output is shifted left by block_len
+	//blocks with a tag less than midkey came from the left list
+	if(block_count == 0) {
+		block_merge_left(beg, last_blocks * block_len, last_len, block_len);
 		return;
+	}
 
-	//search through the right for the position of the first from the left hand side
-	Itr tmp;
-	bool found = stable_binary_search(strt, beg2, end2, beg1, begidx, tmp);
-	if(found) {
-		//if we are moving in an equal item, move to the left while we are looking at equal items (ensures stable ordering)
-		--tmp;
-		for(; tmp != (beg2 - 1) && stable_quick_sort_equal_func(strt, beg1, tmp, begidx); --tmp);
-		++tmp;
+	uint64_t rest_len = block_len;
+	bool rest_right = !less_func(*keys, *midkey);
+	uint64_t pos = block_len;
+	for(uint64_t i = 1; i < block_count; ++i, pos += block_len) {
+		uint64_t rest_pos = pos - rest_len;
+		bool next_right = !less_func(*(keys + i), *midkey);
+		if(next_right == rest_right) {
+			//same list, the remainder is already in order, move it to the output
+			block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+			rest_len = block_len;
+		} else
+			block_merge_smart(beg + rest_pos, rest_len, rest_right, block_len, block_len);
 	}
-	uint64_t pos = distance(beg2, tmp);
 
-	//rotate so that all of the left is in the correct position
-	stable_rotate(strt, beg1, beg2, tmp, begidx);
+	uint64_t rest_pos = pos - rest_len;
+	if(last_len > 0) {
+		//merge what is left with the trailing blocks and the last (partial) block
+		if(rest_right) {
+			block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+			rest_pos = pos;
+			rest_len = block_len * last_blocks;
+		} else
+			rest_len += block_len * last_blocks;
+		block_merge_left(beg + rest_pos, rest_len, last_len, block_len);
+	} else
+		block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+}
+template<typename Itr>
+void block_merge_combine(Itr keys, Itr beg, uint64_t sze, uint64_t run_len, uint64_t block_len) {
+	//merge all pairs of sorted runs of run_len, the buffer is directly before beg
+	uint64_t pairs = sze / (2 * run_len);
+	uint64_t rest = sze % (2 * run_len);
+	if(rest <= run_len) {
+		//the last run has nothing to merge with
+		sze -= rest;
+		rest = 0;
+	}
+
+	for(uint64_t p = 0; p <= pairs; ++p) {
+		if(p == pairs && rest == 0)
+			break;
+		Itr cbeg = beg + p * 2 * run_len;
+		if(!less_func(*(cbeg + run_len), *(cbeg + (run_len - 1)))) {
+			//already in order, just move the buffer past them
+			block_swap(cbeg - block_len, cbeg, (p == pairs ? rest : 2 * run_len));
+			continue;
+		}
+		uint64_t block_count = (p == pairs ? rest : 2 * run_len) / block_len;
+		//put the tags back in order
+		multi_insertion_sort(keys, keys + block_count + 1);
+		Itr midkey = keys + run_len / block_len;
+
+		//selection sort the blocks by their first item, the tags keep equal blocks in their original order
+		for(uint64_t u = 1; u < block_count; ++u) {
+			uint64_t mn = u - 1;
+			for(uint64_t v = u; v < block_count; ++v) {
+				Itr vbeg = cbeg + v * block_len;
+				Itr mbeg = cbeg + mn * block_len;
+				if(less_func(*vbeg, *mbeg) || (!less_func(*mbeg, *vbeg) && less_func(*(keys + v), *(keys + mn))))
+					mn = v;
+			}
+			if(mn != u - 1) {
+				block_swap(cbeg + (u - 1) * block_len, cbeg + mn * block_len, block_len);
+				std::swap(*(keys + (u - 1)), *(keys + mn));
+				//keep track of where the middle key went
+				if(midkey == keys + (u - 1))
+					midkey = keys + mn;
+				else if(midkey == keys + mn)
+					midkey = keys + (u - 1);
+			}
+		}
+
+		//blocks at the end that must go after the last partial block are merged with it directly
+		uint64_t last_blocks = 0;
+		uint64_t last_len = (p == pairs ? rest % block_len : 0);
+		if(last_len > 0) {
+			Itr last = cbeg + block_count * block_len;
+			while(last_blocks < block_count && less_func(*last, *(cbeg + (block_count - last_blocks - 1) * block_len)))
+				++last_blocks;
+		}
+		block_merge_blocks(keys, midkey, cbeg, block_count - last_blocks, block_len, last_blocks, last_len);
+	}
+
+	//everything merged has moved left by block_len, move it back so the buffer is in front again
+	for(Itr it = beg + sze; it != beg;) {
+		--it;
+		std::swap(*it, *(it - block_len));
+	}
+}
+template<typename Itr>
+void block_merge_sort_internal(Itr beg, Itr end, uint64_t insert_count) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+
+	//block length is the first power of 2 where block_len * block_len >= sze
+	uint64_t block_len = insert_count;
+	while(block_len * block_len < sze)
+		block_len *= 2;
+	//we need a unique item for each position in the buffer and a tag for each block
+	uint64_t tag_count = sze / block_len + 1;
+	uint64_t needed = block_len + tag_count;
+	uint64_t key_count = (needed * 2 <= sze ? block_merge_collect_keys(beg, end, needed) : 0);
+	if(key_count < needed) {
+		//too few unique items for the internal buffer, rotate merges are cheap here as runs of equal items are moved together
+		if(insert_count > 1)
+			hybrid_stackless_rotate_merge_sort_internal(beg, end, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+		else
+			rotate_merge_sort(beg, end);
+		return;
+	}
+
+	Itr keys = beg;
+	Itr buf = beg + tag_count;
+	Itr data = beg + needed;
+	uint64_t data_sze = sze - needed;
+
+	//sort small runs with insertion sort before doing merge
+	if(insert_count > 1) {
+		uint64_t count = 0;
+		for(Itr bg = data; bg != end; count += insert_count) {
+			Itr ed = (count + insert_count > data_sze ? end : bg + insert_count);
+			multi_insertion_sort(bg, ed);
+			bg = ed;
+		}
+	}
+
+	//merge runs up to the block length using the buffer as swap space
+	uint64_t len = insert_count;
+	for(; len < block_len && len < data_sze; len *= 2)
+		for(uint64_t pos = 0; pos + len < data_sze; pos += len * 2) {
+			Itr cleft = data + pos;
+			Itr cright = cleft + len;
+			Itr cend = (pos + (len * 2) > data_sze ? end : cleft + (len * 2));
+			block_merge_buffered(cleft, cright, cend, buf);
+		}
+
+	//merge the longer runs by sorting blocks then merging neighbouring blocks
+	for(; len < data_sze; len *= 2)
+		block_merge_combine(keys, data, data_sze, len, block_len);
+
+	//the keys are all unique so sort them then merge them back in
+	multi_insertion_sort(keys, data);
+	rotate_merge(keys, data, end);
+}
+}
+template<typename Itr>
+void block_merge_sort(Itr beg, Itr end) {
+	stlib_internal::block_merge_sort_internal(beg, end, 1);
+}
+template<typename Itr>
+void hybrid_block_merge_sort(Itr beg, Itr end) {
+	stlib_internal::block_merge_sort_internal(beg, end, INSERTION_SORT_CUTOFF);
+}
+
+namespace stlib_internal {
+template<typename Itr, typename Comp>
+uint64_t block_merge_collect_keys(Itr beg, Itr end, uint64_t needed, Comp cmp) {
+	//move the first of each unique item to the front of the list (in sorted order), these are used as the internal buffer and block tags
+	//as they are the first of each item this does not change the order of equal items
+	uint64_t sze = distance(beg, end);
+	uint64_t found = 1;
+	uint64_t keys_pos = 0;
+	for(uint64_t i = 1; i < sze && found < needed; ++i) {
+		Itr keys = beg + keys_pos;
+		Itr pos;
+		if(!binary_search(keys, keys + found, *(beg + i), cmp, pos)) {
+			//bring the keys up to this item, then insert it in order
+			uint64_t offset = distance(keys, pos);
+			stlib_internal::rotate(keys, keys + found, beg + i);
+			keys_pos = i - found;
+			keys = beg + keys_pos;
+			stlib_internal::rotate(keys + offset, beg + i, beg + i + 1);
+			++found;
+		}
+	}
+	//move the keys to the front
+	stlib_internal::rotate(beg, beg + keys_pos, beg + keys_pos + found);
+	return found;
+}
+template<typename Itr, typename Comp>
+void block_merge_buffered(Itr beg1, Itr beg2, Itr end2, Itr buf, Comp cmp) {
+	//merge two neighbouring lists, swapping the left list out into the buffer first (left list must fit in the buffer)
+	//the buffer items end up back in the buffer (in a different order)
+	if(!less_func(*beg2, *(beg2 - 1), cmp))
+		return;
+	Itr left = buf;
+	Itr left_end = buf + distance(beg1, beg2);
+	block_swap(beg1, buf, distance(beg1, beg2));
+	Itr out = beg1;
+	for(; left != left_end && beg2 != end2; ++out)
+		if(less_func(*beg2, *left, cmp)) {
+			std::swap(*out, *beg2);
+			++beg2;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	//whatever is left of the right list is already in place
+	block_swap(out, left, distance(left, left_end));
+}
+template<typename Itr, typename Comp>
+void block_merge_left(Itr beg, uint64_t len1, uint64_t len2, uint64_t block_len, Comp cmp) {
+	//merge two neighbouring lists into the buffer directly before beg, the right list must be no larger than the buffer
+	Itr out = beg - block_len;
+	Itr left = beg;
+	Itr left_end = beg + len1;
+	Itr right = left_end;
+	Itr right_end = right + len2;
+	for(; right != right_end; ++out)
+		if(left == left_end || less_func(*right, *left, cmp)) {
+			std::swap(*out, *right);
+			++right;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	//move the rest of the left list down
+	if(out != left)
+		block_swap(out, left, distance(left, left_end));
+}
+template<typename Itr, typename Comp>
+void block_merge_smart(Itr beg, uint64_t& len1, bool& from_right, uint64_t len2, uint64_t block_len, Comp cmp) {
+	//merge the remainder of the last block with the next block (from the other list) into the buffer directly before beg
+	//what is left over becomes the new remainder, this may be from either list
+	Itr out = beg - block_len;
+	Itr left = beg;
+	Itr left_end = beg + len1;
+	Itr right = left_end;
+	Itr right_end = right + len2;
+	for(; left != left_end && right != right_end; ++out)
+		//equal items from the left list go first, unless the remainder came from the right list
+		if(from_right ? !less_func(*left, *right, cmp) : less_func(*right, *left, cmp)) {
+			std::swap(*out, *right);
+			++right;
+		} else {
+			std::swap(*out, *left);
+			++left;
+		}
+	if(left != left_end) {
+		//move the rest of the remainder to the end, after the buffer
+		len1 = distance(left, left_end);
+		while(left != left_end)
+			std::swap(*--left_end, *--right_end);
+	} else {
+		//the rest of the block is in place and is the new remainder
+		len1 = distance(right, right_end);
+		from_right = !from_right;
+	}
+}
+template<typename Itr, typename Comp>
+void block_merge_blocks(Itr keys, Itr midkey, Itr beg, uint64_t block_count, uint64_t block_len,
+						uint64_t last_blocks, uint64_t last_len, Comp cmp) {
+	//merge the sorted blocks into the buffer directly before beg, the output is shifted left by block_len
+	//blocks with a tag less than midkey came from the left list
+	if(block_count == 0) {
+		block_merge_left(beg, last_blocks * block_len, last_len, block_len, cmp);
+		return;
+	}
+
+	uint64_t rest_len = block_len;
+	bool rest_right = !less_func(*keys, *midkey, cmp);
+	uint64_t pos = block_len;
+	for(uint64_t i = 1; i < block_count; ++i, pos += block_len) {
+		uint64_t rest_pos = pos - rest_len;
+		bool next_right = !less_func(*(keys + i), *midkey, cmp);
+		if(next_right == rest_right) {
+			//same list, the remainder is already in order, move it to the output
+			block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+			rest_len = block_len;
+		} else
+			block_merge_smart(beg + rest_pos, rest_len, rest_right, block_len, block_len, cmp);
+	}
+
+	uint64_t rest_pos = pos - rest_len;
+	if(last_len > 0) {
+		//merge what is left with the trailing blocks and the last (partial) block
+		if(rest_right) {
+			block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+			rest_pos = pos;
+			rest_len = block_len * last_blocks;
+		} else
+			rest_len += block_len * last_blocks;
+		block_merge_left(beg + rest_pos, rest_len, last_len, block_len, cmp);
+	} else
+		block_swap(beg + rest_pos - block_len, beg + rest_pos, rest_len);
+}
+template<typename Itr, typename Comp>
+void block_merge_combine(Itr keys, Itr beg, uint64_t sze, uint64_t run_len, uint64_t block_len, Comp cmp) {
+	//merge all pairs of sorted runs of run_len, the buffer is directly before beg
+	uint64_t pairs = sze / (2 * run_len);
+	uint64_t rest = sze % (2 * run_len);
+	if(rest <= run_len) {
+		//the last run has nothing to merge with
+		sze -= rest;
+		rest = 0;
+	}
+
+	for(uint64_t p = 0; p <= pairs; ++p) {
+		if(p == pairs && rest == 0)
+			break;
+		Itr cbeg = beg + p * 2 * run_len;
+		if(!less_func(*(cbeg + run_len), *(cbeg + (run_len - 1)), cmp)) {
+			//already in order, just move the buffer past them
+			block_swap(cbeg - block_len, cbeg, (p == pairs ? rest : 2 * run_len));
+			continue;
+		}
+		uint64_t block_count = (p == pairs ? rest : 2 * run_len) / block_len;
+		//put the tags back in order
+		multi_insertion_sort(keys, keys + block_count + 1, cmp);
+		Itr midkey = keys + run_len / block_len;
+
+		//selection sort the blocks by their first item, the tags keep equal blocks in their original order
+		for(uint64_t u = 1; u < block_count; ++u) {
+			uint64_t mn = u - 1;
+			for(uint64_t v = u; v < block_count; ++v) {
+				Itr vbeg = cbeg + v * block_len;
+				Itr mbeg = cbeg + mn * block_len;
+				if(less_func(*vbeg, *mbeg, cmp) || (!less_func(*mbeg, *vbeg, cmp) && less_func(*(keys + v), *(keys + mn), cmp)))
+					mn = v;
+			}
+			if(mn != u - 1) {
+				block_swap(cbeg + (u - 1) * block_len, cbeg + mn * block_len, block_len);
+				std::swap(*(keys + (u - 1)), *(keys + mn));
+				//keep track of where the middle key went
+				if(midkey == keys + (u - 1))
+					midkey = keys + mn;
+				else if(midkey == keys + mn)
+					midkey = keys + (u - 1);
+			}
+		}
+
+		//blocks at the end that must go after the last partial block are merged with it directly
+		uint64_t last_blocks = 0;
+		uint64_t last_len = (p == pairs ? rest % block_len : 0);
+		if(last_len > 0) {
+			Itr last = cbeg + block_count * block_len;
+			while(last_blocks < block_count && less_func(*last, *(cbeg + (block_count - last_blocks - 1) * block_len), cmp))
+				++last_blocks;
+		}
+		block_merge_blocks(keys, midkey, cbeg, block_count - last_blocks, block_len, last_blocks, last_len, cmp);
+	}
+
+	//everything merged has moved left by block_len, move it back so the buffer is in front again
+	for(Itr it = beg + sze; it != beg;) {
+		--it;
+		std::swap(*it, *(it - block_len));
+	}
+}
+template<typename Itr, typename Comp>
+void block_merge_sort_internal(Itr beg, Itr end, uint64_t insert_count, Comp cmp) {
+	uint64_t sze = distance(beg, end);
+	if(sze <= 1)
+		return;
+
+	//block length is the first power of 2 where block_len * block_len >= sze
+	uint64_t block_len = insert_count;
+	while(block_len * block_len < sze)
+		block_len *= 2;
+	//we need a unique item for each position in the buffer and a tag for each block
+	uint64_t tag_count = sze / block_len + 1;
+	uint64_t needed = block_len + tag_count;
+	uint64_t key_count = (needed * 2 <= sze ? block_merge_collect_keys(beg, end, needed, cmp) : 0);
+	if(key_count < needed) {
+		//too few unique items for the internal buffer, rotate merges are cheap here as runs of equal items are moved together
+		if(insert_count > 1)
+			hybrid_stackless_rotate_merge_sort_internal(beg, end, cmp, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+		else
+			rotate_merge_sort(beg, end, cmp);
+		return;
+	}
+
+	Itr keys = beg;
+	Itr buf = beg + tag_count;
+	Itr data = beg + needed;
+	uint64_t data_sze = sze - needed;
+
+	//sort small runs with insertion sort before doing merge
+	if(insert_count > 1) {
+		uint64_t count = 0;
+		for(Itr bg = data; bg != end; count += insert_count) {
+			Itr ed = (count + insert_count > data_sze ? end : bg + insert_count);
+			multi_insertion_sort(bg, ed, cmp);
+			bg = ed;
+		}
+	}
+
+	//merge runs up to the block length using the buffer as swap space
+	uint64_t len = insert_count;
+	for(; len < block_len && len < data_sze; len *= 2)
+		for(uint64_t pos = 0; pos + len < data_sze; pos += len * 2) {
+			Itr cleft = data + pos;
+			Itr cright = cleft + len;
+			Itr cend = (pos + (len * 2) > data_sze ? end : cleft + (len * 2));
+			block_merge_buffered(cleft, cright, cend, buf, cmp);
+		}
+
+	//merge the longer runs by sorting blocks then merging neighbouring blocks
+	for(; len < data_sze; len *= 2)
+		block_merge_combine(keys, data, data_sze, len, block_len, cmp);
+
+	//the keys are all unique so sort them then merge them back in
+	multi_insertion_sort(keys, data, cmp);
+	rotate_merge(keys, data, end, cmp);
+}
+}
+template<typename Itr, typename Comp>
+void block_merge_sort(Itr beg, Itr end, Comp cmp) {
+	stlib_internal::block_merge_sort_internal(beg, end, 1, cmp);
+}
+template<typename Itr, typename Comp>
+void hybrid_block_merge_sort(Itr beg, Itr end, Comp cmp) {
+	stlib_internal::block_merge_sort_internal(beg, end, INSERTION_SORT_CUTOFF, cmp);
+}
+
+
+
+namespace stlib_internal {
+//for use with stable intro sort (depth > maxdepth)
+template<typename Itr, typename IdxItr>
+void stable_inner_rotate_merge(Itr strt, Itr beg1, Itr beg2, Itr end2, IdxItr begidx, Itr& out) {
+	//if size == 0 return
+	uint64_t sze = distance(beg1, beg2);
+	if(sze == 0)
+		return;
+
+	//search through the right for the position of the first from the left hand side
+	Itr tmp;
+	bool found = stable_binary_search(strt, beg2, end2, beg1, begidx, tmp);
+	if(found) {
+		//if we are moving in an equal item, move to the left while we are looking at equal items (ensures stable ordering)
+		--tmp;
+		for(; tmp != (beg2 - 1) && stable_quick_sort_equal_func(strt, beg1, tmp, begidx); --tmp);
+		++tmp;
+	}
+	uint64_t pos = distance(beg2, tmp);
+
+	//rotate so that all of the left is in the correct position
+	stable_rotate(strt, beg1, beg2, tmp, begidx);
 	out = beg1 + pos;
 
 	if(sze == 1) return;
@@ -4379,15 +6694,6 @@ void zip_sort_rec2(Itr beg, Itr end, Comp cmp) {
 
 
 
-enum class NEW_ZIP_MERGE_KIND : uint8_t {
-	NZMK_RECURSIVE,
-	//possibly slightly faster than above
-	NZMK_ROTATE_MERGE,
-	//slower than both of the above options, gives constant memory usage
-	NZMK_INPLACE_MERGE,
-	//calls older zip_merge, gives constant memory usage
-	NZMK_ZIP_MERGE
-};
 namespace stlib_internal {
 template<typename Itr>
 void inplace_merge(Itr beg1, Itr beg2, Itr end2);
@@ -4438,6 +6744,12 @@ void new_zip_sort_do_merge(Itr left, Itr right, Itr end, NEW_ZIP_MERGE_KIND kind
 	case NEW_ZIP_MERGE_KIND::NZMK_INPLACE_MERGE:
 		stlib_internal::inplace_merge(left, right, end);
 		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_SYM_MERGE:
+		sym_merge(left, right, end);
+		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_BINARY_MERGE:
+		binary_merge(left, right, end);
+		break;
 	default:
 		zip_merge(left, right, end);
 		break;
@@ -4888,6 +7200,12 @@ void new_zip_sort_do_merge(Itr left, Itr right, Itr end, Comp cmp, NEW_ZIP_MERGE
 	case NEW_ZIP_MERGE_KIND::NZMK_INPLACE_MERGE:
 		stlib_internal::inplace_merge(left, right, end, cmp);
 		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_SYM_MERGE:
+		sym_merge(left, right, end, cmp);
+		break;
+	case NEW_ZIP_MERGE_KIND::NZMK_BINARY_MERGE:
+		binary_merge(left, right, end, cmp);
+		break;
 	default:
 		zip_merge(left, right, end, cmp);
 		break;
@@ -5330,7 +7648,175 @@ void new_zip_sort_rec2(Itr beg, Itr end, Comp cmp, NEW_ZIP_MERGE_KIND kind = NEW
 
 namespace stlib_internal {
 template<typename Itr>
-void intro_quick_sort_internal(Itr beg, Itr end) {
+Itr partition_equal(Itr beg, Itr end, Itr pivot) {
+	//no item in the list is less than the pivot, move the ones equal to it to the left and return the end of them
+	std::swap(*beg, *pivot);
+	Itr left = beg + 1;
+	Itr right = end;
+	for(;;) {
+		while(left != right && !less_func(*beg, *left))
+			++left;
+		while(left != right && less_func(*beg, *(right - 1)))
+			--right;
+		if(left == right)
+			return left;
+		--right;
+		std::swap(*left, *right);
+		++left;
+	}
+}
+template<typename Itr, typename Comp>
+Itr partition_equal(Itr beg, Itr end, Itr pivot, Comp cmp) {
+	//no item in the list is less than the pivot, move the ones equal to it to the left and return the end of them
+	std::swap(*beg, *pivot);
+	Itr left = beg + 1;
+	Itr right = end;
+	for(;;) {
+		while(left != right && !less_func(*beg, *left, cmp))
+			++left;
+		while(left != right && less_func(*beg, *(right - 1), cmp))
+			--right;
+		if(left == right)
+			return left;
+		--right;
+		std::swap(*left, *right);
+		++left;
+	}
+}
+template<typename Itr>
+Itr intro_partition(Itr first, Itr last, Itr pivot) {
+	//partition [first, last) around the item at pivot, the pivot ends up between the two sides and is returned
+	Itr left = first - 1;
+	Itr right = last;
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && less_func(*left, *pivot))
+			++left;
+		while(left != right && greater_equal_func(*right, *pivot))
+			--right;
+		if(left == right)
+			break;
+
+		std::swap(*left, *right);
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(less_func(*right, *pivot))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			std::swap(*right, *pivot);
+			pivot = right;
+		}
+	}
+	return pivot;
+}
+template<typename Itr, typename Comp>
+Itr intro_partition(Itr first, Itr last, Itr pivot, Comp cmp) {
+	//partition [first, last) around the item at pivot, the pivot ends up between the two sides and is returned
+	Itr left = first - 1;
+	Itr right = last;
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && less_func(*left, *pivot, cmp))
+			++left;
+		while(left != right && greater_equal_func(*right, *pivot, cmp))
+			--right;
+		if(left == right)
+			break;
+
+		std::swap(*left, *right);
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(less_func(*right, *pivot, cmp))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			std::swap(*right, *pivot);
+			pivot = right;
+		}
+	}
+	return pivot;
+}
+template<typename Itr, typename IdxItr>
+Itr stable_intro_partition(Itr beg, Itr first, Itr last, Itr pivot, IdxItr begidx) {
+	//as intro_partition, but ties are broken by the index of each item (in begidx, which is for the list starting at beg)
+	Itr left = first - 1;
+	Itr right = last;
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && stable_quick_sort_less_func(beg, left, pivot, begidx))
+			++left;
+		while(left != right && stable_quick_sort_greater_equal_func(beg, right, pivot, begidx))
+			--right;
+		if(left == right)
+			break;
+
+		stable_quick_sort_swap(beg, left, right, begidx);
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(stable_quick_sort_less_func(beg, right, pivot, begidx))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			stable_quick_sort_swap(beg, right, pivot, begidx);
+			pivot = right;
+		}
+	}
+	return pivot;
+}
+template<typename Itr, typename IdxItr, typename Comp>
+Itr stable_intro_partition(Itr beg, Itr first, Itr last, Itr pivot, IdxItr begidx, Comp cmp) {
+	//as intro_partition, but ties are broken by the index of each item (in begidx, which is for the list starting at beg)
+	Itr left = first - 1;
+	Itr right = last;
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && stable_quick_sort_less_func(beg, left, pivot, begidx, cmp))
+			++left;
+		while(left != right && stable_quick_sort_greater_equal_func(beg, right, pivot, begidx, cmp))
+			--right;
+		if(left == right)
+			break;
+
+		stable_quick_sort_swap(beg, left, right, begidx);
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(stable_quick_sort_less_func(beg, right, pivot, begidx, cmp))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			stable_quick_sort_swap(beg, right, pivot, begidx);
+			pivot = right;
+		}
+	}
+	return pivot;
+}
+template<typename Itr>
+void intro_quick_sort_internal(Itr beg, Itr end, DEPTH_FALLBACK_KIND fallback) {
 	if(distance(beg, end) <= 1)
 		return;
 	unsigned maxdepth = get_depth(distance(beg, end));
@@ -5348,55 +7834,36 @@ void intro_quick_sort_internal(Itr beg, Itr end) {
 
 	while(idx > 0) {
 		intro_stack_less_data<Itr> tmp = stk[--idx];
-		Itr left = tmp.beg - 1;
-		Itr right = tmp.end + 1;
 		Itr pivot = middle_of_three(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end);
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot)) {
+			Itr mid = partition_equal(tmp.beg, tmp.end + 1, pivot);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				add_stack_item(mid, tmp.end + 1, mid, tmp.end, tmp.depth, stk, idx, fallback);
+			continue;
+		}
 
-		do {
-			++left;
-			--right;
-			//pivot goes to the right!!
-			while(left != right && left != pivot && less_func(*left, *pivot))
-				++left;
-			while(left != right && greater_equal_func(*right, *pivot))
-				--right;
-			if(left == right)
-				break;
-
-			std::swap(*left, *right);
-			if(left == pivot)
-				pivot = right;
-		} while(left + 1 != right);
-
-		//if right is on the less side, move back
-		if(right != pivot) {
-			if(less_func(*right, *pivot))
-				++right;
-			//move the pivot into place
-			if(right != pivot) {
-				std::swap(*right, *pivot);
-				pivot = right;
-			}
-		}
+		pivot = intro_partition(tmp.beg, tmp.end + 1, pivot);
 
 		auto dist1 = distance(pivot + 1, tmp.end + 1);
 		auto dist2 = distance(tmp.beg, pivot);
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, fallback);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, fallback);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, fallback);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, fallback);
 		}
 	}
 }
 template<typename Itr, typename Comp>
-void intro_quick_sort_internal(Itr beg, Itr end, Comp cmp) {
+void intro_quick_sort_internal(Itr beg, Itr end, Comp cmp, DEPTH_FALLBACK_KIND fallback) {
 	if(distance(beg, end) <= 1)
 		return;
 	unsigned maxdepth = get_depth(distance(beg, end));
@@ -5414,73 +7881,274 @@ void intro_quick_sort_internal(Itr beg, Itr end, Comp cmp) {
 
 	while(idx > 0) {
 		intro_stack_less_data<Itr> tmp = stk[--idx];
-		Itr left = tmp.beg - 1;
-		Itr right = tmp.end + 1;
 		Itr pivot = middle_of_three(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, cmp);
-
-		do {
-			++left;
-			--right;
-			//pivot goes to the right!!
-			while(left != right && left != pivot && less_func(*left, *pivot, cmp))
-				++left;
-			while(left != right && greater_equal_func(*right, *pivot, cmp))
-				--right;
-			if(left == right)
-				break;
-
-			std::swap(*left, *right);
-			if(left == pivot)
-				pivot = right;
-		} while(left + 1 != right);
-
-		//if right is on the less side, move back
-		if(right != pivot) {
-			if(less_func(*right, *pivot, cmp))
-				++right;
-			//move the pivot into place
-			if(right != pivot) {
-				std::swap(*right, *pivot);
-				pivot = right;
-			}
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot, cmp)) {
+			Itr mid = partition_equal(tmp.beg, tmp.end + 1, pivot, cmp);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				add_stack_item(mid, tmp.end + 1, mid, tmp.end, tmp.depth, stk, idx, cmp, fallback);
+			continue;
 		}
 
+		pivot = intro_partition(tmp.beg, tmp.end + 1, pivot, cmp);
+
 		auto dist1 = distance(pivot + 1, tmp.end + 1);
 		auto dist2 = distance(tmp.beg, pivot);
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp, fallback);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp, fallback);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp, fallback);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp, fallback);
 		}
 	}
 }
 }
 
 template<typename Itr>
-void intro_quick_sort(Itr beg, Itr end) {
-	stlib_internal::intro_quick_sort_internal(beg, end);
+void intro_quick_sort(Itr beg, Itr end, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT) {
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT)
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, fallback, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+	else
+		stlib_internal::intro_quick_sort_internal(beg, end, fallback);
 
 	multi_insertion_sort(beg, end);
 }
 template<typename Itr, typename Comp>
-void intro_quick_sort(Itr beg, Itr end, Comp cmp) {
-	stlib_internal::intro_quick_sort_internal(beg, end, cmp);
+void intro_quick_sort(Itr beg, Itr end, Comp cmp, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT) {
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT)
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, cmp, fallback, SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT);
+	else
+		stlib_internal::intro_quick_sort_internal(beg, end, cmp, fallback);
 
 	multi_insertion_sort(beg, end, cmp);
 }
 
 namespace stlib_internal {
 template<typename Itr>
-void adaptive_intro_quick_sort(Itr beg, Itr end) {
+struct use_block_partition {
+	//block partition only pays off when comparisons are cheap and can be done without branching
+	using valueof = typename std::remove_cv<typename value_for<Itr>::value_type>::type;
+	static constexpr bool value = std::is_arithmetic<valueof>::value && !std::is_same<valueof, bool>::value;
+};
+template<typename Itr>
+Itr block_partition(Itr beg, Itr end, bool& partitioned) {
+	//BlockQuicksort partition (as in pdqsort), the pivot is at beg, items less than it go to the left the rest to the right
+	//the items to swap are found a block at a time and their offsets stored without branching, then swapped in one go
+	using valueof = typename value_for<Itr>::value_type;
+	valueof pivot = std::move(*beg);
+	Itr first = beg + 1;
+	Itr last = end;
+	while(first != last && less_func(*first, pivot))
+		++first;
+	while(first != last && !less_func(*(last - 1), pivot))
+		--last;
+
+	partitioned = (first == last);
+	if(!partitioned) {
+		--last;
+		std::swap(*first, *last);
+		++first;
+
+		unsigned char offsets_l[BLOCK_PARTITION_SIZE];
+		unsigned char offsets_r[BLOCK_PARTITION_SIZE];
+		unsigned num_l = 0;
+		unsigned num_r = 0;
+		unsigned start_l = 0;
+		unsigned start_r = 0;
+		while(distance(first, last) > 2 * BLOCK_PARTITION_SIZE) {
+			//fill up the offsets of the items on the wrong side
+			if(num_l == 0) {
+				start_l = 0;
+				Itr it = first;
+				for(unsigned i = 0; i < BLOCK_PARTITION_SIZE; ++it) {
+					offsets_l[num_l] = i++;
+					num_l += !less_func(*it, pivot);
+				}
+			}
+			if(num_r == 0) {
+				start_r = 0;
+				Itr it = last;
+				for(unsigned i = 0; i < BLOCK_PARTITION_SIZE;) {
+					offsets_r[num_r] = ++i;
+					num_r += less_func(*--it, pivot);
+				}
+			}
+
+			//swap as many as we can
+			unsigned num = (num_l < num_r ? num_l : num_r);
+			for(unsigned i = 0; i < num; ++i)
+				std::swap(*(first + offsets_l[start_l + i]), *(last - offsets_r[start_r + i]));
+			num_l -= num;
+			num_r -= num;
+			start_l += num;
+			start_r += num;
+			if(num_l == 0)
+				first += BLOCK_PARTITION_SIZE;
+			if(num_r == 0)
+				last -= BLOCK_PARTITION_SIZE;
+		}
+
+		//what is left is split between the two sides, a side still with offsets keeps its full block
+		unsigned l_size = 0;
+		unsigned r_size = 0;
+		unsigned unknown = (unsigned)distance(first, last) - ((num_r || num_l) ? BLOCK_PARTITION_SIZE : 0);
+		if(num_r) {
+			l_size = unknown;
+			r_size = BLOCK_PARTITION_SIZE;
+		} else if(num_l) {
+			l_size = BLOCK_PARTITION_SIZE;
+			r_size = unknown;
+		} else {
+			l_size = unknown / 2;
+			r_size = unknown - l_size;
+		}
+		if(unknown && !num_l) {
+			start_l = 0;
+			Itr it = first;
+			for(unsigned i = 0; i < l_size; ++it) {
+				offsets_l[num_l] = i++;
+				num_l += !less_func(*it, pivot);
+			}
+		}
+		if(unknown && !num_r) {
+			start_r = 0;
+			Itr it = last;
+			for(unsigned i = 0; i < r_size;) {
+				offsets_r[num_r] = ++i;
+				num_r += less_func(*--it, pivot);
+			}
+		}
+		unsigned num = (num_l < num_r ? num_l : num_r);
+		for(unsigned i = 0; i < num; ++i)
+			std::swap(*(first + offsets_l[start_l + i]), *(last - offsets_r[start_r + i]));
+		num_l -= num;
+		num_r -= num;
+		start_l += num;
+		start_r += num;
+		if(num_l == 0)
+			first += l_size;
+		if(num_r == 0)
+			last -= r_size;
+
+		//one side may still have items on the wrong side, swap them to the middle
+		if(num_l) {
+			while(num_l--)
+				std::swap(*(first + offsets_l[start_l + num_l]), *--last);
+			first = last;
+		}
+		if(num_r) {
+			while(num_r--) {
+				std::swap(*(last - offsets_r[start_r + num_r]), *first);
+				++first;
+			}
+			last = first;
+		}
+	}
+
+	//put the pivot in place
+	Itr pivot_pos = first - 1;
+	*beg = std::move(*pivot_pos);
+	*pivot_pos = std::move(pivot);
+	return pivot_pos;
+}
+template<typename Itr>
+Itr adaptive_intro_partition(Itr beg, Itr end, Itr pivot, bool& partitioned, std::true_type) {
+	//move the pivot to the front out of the way
+	std::swap(*beg, *pivot);
+	return block_partition(beg, end, partitioned);
+}
+template<typename Itr>
+void break_patterns(Itr beg, Itr end) {
+	//swap a few items from the ends with items a quarter of the way in (as in pdqsort), this is deterministic
+	auto sze = distance(beg, end);
+	if(sze < INSERTION_SORT_CUTOFF)
+		return;
+	std::swap(*beg, *(beg + sze / 4));
+	std::swap(*(end - 1), *(end - sze / 4));
+	if(sze > 128) {
+		std::swap(*(beg + 1), *(beg + (sze / 4 + 1)));
+		std::swap(*(beg + 2), *(beg + (sze / 4 + 2)));
+		std::swap(*(end - 2), *(end - (sze / 4 + 1)));
+		std::swap(*(end - 3), *(end - (sze / 4 + 2)));
+	}
+}
+template<typename Itr>
+Itr adaptive_intro_partition(Itr beg, Itr end, Itr pivot, bool& partitioned, std::false_type) {
+	Itr left = beg - 1;
+	Itr right = end;
+	unsigned swaps = 0;
+
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && less_func(*left, *pivot))
+			++left;
+		while(left != right && greater_equal_func(*right, *pivot))
+			--right;
+		if(left == right)
+			break;
+
+		std::swap(*left, *right);
+		++swaps;
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(less_func(*right, *pivot))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			std::swap(*right, *pivot);
+			++swaps;
+			pivot = right;
+		}
+	}
+	partitioned = (swaps == 0);
+	return pivot;
+}
+template<typename Itr>
+bool partial_insertion_sort(Itr beg, Itr end) {
+	//insertion sort that gives up once it has moved more than PARTIAL_INSERTION_SORT_LIMIT items, returns true if the list is now sorted
+	using valueof = typename value_for<Itr>::value_type;
 	if(distance(beg, end) <= 1)
+		return true;
+	uint64_t moved = 0;
+	for(Itr cur = beg + 1; cur != end; ++cur) {
+		Itr sift = cur;
+		Itr sift_1 = cur - 1;
+		if(less_func(*sift, *sift_1)) {
+			valueof tmp = std::move(*sift);
+			do {
+				*sift = std::move(*sift_1);
+				--sift;
+			} while(sift != beg && less_func(tmp, *--sift_1));
+			*sift = std::move(tmp);
+			moved += distance(sift, cur);
+		}
+		if(moved > PARTIAL_INSERTION_SORT_LIMIT)
+			return false;
+	}
+	return true;
+}
+template<typename Itr>
+void adaptive_intro_quick_sort(Itr beg, Itr end, DEPTH_FALLBACK_KIND fallback, SMALL_SORT_KIND small) {
+	if(distance(beg, end) <= 1)
+		return;
+	//a reversed list defeats the partial insertion sort below, just reverse it (this stops at the first ascending pair so costs almost nothing otherwise)
+	if(stlib::is_reverse_sorted(beg, end)) {
+		stlib_internal::reverse(beg, end);
 		return;
+	}
 	unsigned maxdepth = get_depth(distance(beg, end));
 
 	//add a stack item
@@ -5496,62 +8164,123 @@ void adaptive_intro_quick_sort(Itr beg, Itr end) {
 
 	while(idx > 0) {
 		intro_stack_less_data<Itr> tmp = stk[--idx];
-		Itr left = tmp.beg - 1;
-		Itr right = tmp.end + 1;
-		unsigned swaps = 0;
+		bool partitioned = false;
 		Itr pivot = middle_of_four(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end);
-
-		do {
-			++left;
-			--right;
-			//pivot goes to the right!!
-			while(left != right && left != pivot && less_func(*left, *pivot))
-				++left;
-			while(left != right && greater_equal_func(*right, *pivot))
-				--right;
-			if(left == right)
-				break;
-
-			std::swap(*left, *right);
-			++swaps;
-			if(left == pivot)
-				pivot = right;
-		} while(left + 1 != right);
-
-		//if right is on the less side, move back
-		if(right != pivot) {
-			if(less_func(*right, *pivot))
-				++right;
-			//move the pivot into place
-			if(right != pivot) {
-				std::swap(*right, *pivot);
-				++swaps;
-				pivot = right;
-			}
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot)) {
+			Itr mid = partition_equal(tmp.beg, tmp.end + 1, pivot);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				add_stack_item(mid, tmp.end + 1, mid, tmp.end, tmp.depth, stk, idx, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(mid, tmp.end + 1);
+			continue;
 		}
+		pivot = adaptive_intro_partition(tmp.beg, tmp.end + 1, pivot, partitioned, std::integral_constant<bool, use_block_partition<Itr>::value>());
 
 		auto dist1 = distance(pivot + 1, tmp.end + 1);
 		auto dist2 = distance(tmp.beg, pivot);
-		if(swaps == 0 && ((dist1 > INSERTION_SORT_CUTOFF) | (dist2 > INSERTION_SORT_CUTOFF)) && stlib::is_sorted(tmp.beg, tmp.end + 1)) continue;
+		auto sze = dist1 + dist2 + 1;
+		if(dist1 < sze / 8 || dist2 < sze / 8) {
+			//very unbalanced, swap some items around in both halves so any pattern in the input doesn't do the same to the next partition
+			break_patterns(tmp.beg, pivot);
+			break_patterns(pivot + 1, tmp.end + 1);
+		} else if(partitioned && partial_insertion_sort(tmp.beg, pivot) && partial_insertion_sort(pivot + 1, tmp.end + 1))
+			//nothing needed moving, if this was nearly sorted then insertion sort will have finished it off
+			continue;
 
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(tmp.beg, pivot);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(pivot + 1, tmp.end + 1);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(pivot + 1, tmp.end + 1);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(tmp.beg, pivot);
 		}
 	}
 }
 template<typename Itr, typename Comp>
-void adaptive_intro_quick_sort(Itr beg, Itr end, Comp cmp) {
+Itr adaptive_intro_partition(Itr beg, Itr end, Itr pivot, bool& partitioned, Comp cmp) {
+	Itr left = beg - 1;
+	Itr right = end;
+	unsigned swaps = 0;
+
+	do {
+		++left;
+		--right;
+		//pivot goes to the right!!
+		while(left != right && left != pivot && less_func(*left, *pivot, cmp))
+			++left;
+		while(left != right && greater_equal_func(*right, *pivot, cmp))
+			--right;
+		if(left == right)
+			break;
+
+		std::swap(*left, *right);
+		++swaps;
+		if(left == pivot)
+			pivot = right;
+	} while(left + 1 != right);
+
+	//if right is on the less side, move back
+	if(right != pivot) {
+		if(less_func(*right, *pivot, cmp))
+			++right;
+		//move the pivot into place
+		if(right != pivot) {
+			std::swap(*right, *pivot);
+			++swaps;
+			pivot = right;
+		}
+	}
+	partitioned = (swaps == 0);
+	return pivot;
+}
+template<typename Itr, typename Comp>
+bool partial_insertion_sort(Itr beg, Itr end, Comp cmp) {
+	//insertion sort that gives up once it has moved more than PARTIAL_INSERTION_SORT_LIMIT items, returns true if the list is now sorted
+	using valueof = typename value_for<Itr>::value_type;
+	if(distance(beg, end) <= 1)
+		return true;
+	uint64_t moved = 0;
+	for(Itr cur = beg + 1; cur != end; ++cur) {
+		Itr sift = cur;
+		Itr sift_1 = cur - 1;
+		if(less_func(*sift, *sift_1, cmp)) {
+			valueof tmp = std::move(*sift);
+			do {
+				*sift = std::move(*sift_1);
+				--sift;
+			} while(sift != beg && less_func(tmp, *--sift_1, cmp));
+			*sift = std::move(tmp);
+			moved += distance(sift, cur);
+		}
+		if(moved > PARTIAL_INSERTION_SORT_LIMIT)
+			return false;
+	}
+	return true;
+}
+template<typename Itr, typename Comp>
+void adaptive_intro_quick_sort(Itr beg, Itr end, Comp cmp, DEPTH_FALLBACK_KIND fallback, SMALL_SORT_KIND small) {
 	if(distance(beg, end) <= 1)
 		return;
+	//a reversed list defeats the partial insertion sort below, just reverse it (this stops at the first ascending pair so costs almost nothing otherwise)
+	if(stlib::is_reverse_sorted(beg, end, cmp)) {
+		stlib_internal::reverse(beg, end);
+		return;
+	}
 	unsigned maxdepth = get_depth(distance(beg, end));
 
 	//add a stack item
@@ -5567,55 +8296,50 @@ void adaptive_intro_quick_sort(Itr beg, Itr end, Comp cmp) {
 
 	while(idx > 0) {
 		intro_stack_less_data<Itr> tmp = stk[--idx];
-		Itr left = tmp.beg - 1;
-		Itr right = tmp.end + 1;
-		unsigned swaps = 0;
+		bool partitioned = false;
 		Itr pivot = middle_of_four(tmp.beg, half_point(tmp.beg, tmp.end + 1), tmp.end, cmp);
-
-		do {
-			++left;
-			--right;
-			//pivot goes to the right!!
-			while(left != right && left != pivot && less_func(*left, *pivot, cmp))
-				++left;
-			while(left != right && greater_equal_func(*right, *pivot, cmp))
-				--right;
-			if(left == right)
-				break;
-
-			std::swap(*left, *right);
-			++swaps;
-			if(left == pivot)
-				pivot = right;
-		} while(left + 1 != right);
-
-		//if right is on the less side, move back
-		if(right != pivot) {
-			if(less_func(*right, *pivot, cmp))
-				++right;
-			//move the pivot into place
-			if(right != pivot) {
-				std::swap(*right, *pivot);
-				++swaps;
-				pivot = right;
-			}
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(tmp.beg != beg && !less_func(*(tmp.beg - 1), *pivot, cmp)) {
+			Itr mid = partition_equal(tmp.beg, tmp.end + 1, pivot, cmp);
+			if(distance(mid, tmp.end + 1) > INSERTION_SORT_CUTOFF)
+				add_stack_item(mid, tmp.end + 1, mid, tmp.end, tmp.depth, stk, idx, cmp, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(mid, tmp.end + 1, cmp);
+			continue;
 		}
+		pivot = adaptive_intro_partition(tmp.beg, tmp.end + 1, pivot, partitioned, cmp);
 
 		auto dist1 = distance(pivot + 1, tmp.end + 1);
 		auto dist2 = distance(tmp.beg, pivot);
-		if(swaps == 0 && ((dist1 > INSERTION_SORT_CUTOFF) | (dist2 > INSERTION_SORT_CUTOFF)) && stlib::is_sorted(tmp.beg, tmp.end + 1, cmp)) continue;
+		auto sze = dist1 + dist2 + 1;
+		if(dist1 < sze / 8 || dist2 < sze / 8) {
+			//very unbalanced, swap some items around in both halves so any pattern in the input doesn't do the same to the next partition
+			break_patterns(tmp.beg, pivot);
+			break_patterns(pivot + 1, tmp.end + 1);
+		} else if(partitioned && partial_insertion_sort(tmp.beg, pivot, cmp) && partial_insertion_sort(pivot + 1, tmp.end + 1, cmp))
+			//nothing needed moving, if this was nearly sorted then insertion sort will have finished it off
+			continue;
 
 		//implements sort shorter first optimisation
 		if(dist1 < dist2) {
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(tmp.beg, pivot, cmp);
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(pivot + 1, tmp.end + 1, cmp);
 		} else {
 			if(dist1 > INSERTION_SORT_CUTOFF)
-				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp);
+				add_stack_item(pivot + 1, tmp.end + 1, pivot + 1, tmp.end, tmp.depth, stk, idx, cmp, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(pivot + 1, tmp.end + 1, cmp);
 			if(dist2 > INSERTION_SORT_CUTOFF)
-				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp);
+				add_stack_item(tmp.beg, pivot, tmp.beg, pivot - 1, tmp.depth, stk, idx, cmp, fallback);
+			else if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE)
+				parity_merge_small_sort(tmp.beg, pivot, cmp);
 		}
 	}
 }
@@ -5623,16 +8347,187 @@ void adaptive_intro_quick_sort(Itr beg, Itr end, Comp cmp) {
 
 
 template<typename Itr>
-inline void intro_sort(Itr beg, Itr end) {
-	stlib_internal::adaptive_intro_quick_sort(beg, end);
+inline void intro_sort(Itr beg, Itr end, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT,
+					   SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT) {
+	//with the parity merge small partitions are sorted as they are made, otherwise they are all finished with multi_insertion_sort
+	if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE && distance(beg, end) <= INSERTION_SORT_CUTOFF) {
+		stlib_internal::parity_merge_small_sort(beg, end);
+		return;
+	}
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT)
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, fallback, small);
+	else
+		stlib_internal::adaptive_intro_quick_sort(beg, end, fallback, small);
 
-	multi_insertion_sort(beg, end);
+	if(small != SMALL_SORT_KIND::SSK_PARITY_MERGE)
+		multi_insertion_sort(beg, end);
 }
 template<typename Itr, typename Comp>
-inline void intro_sort(Itr beg, Itr end, Comp cmp) {
-	stlib_internal::adaptive_intro_quick_sort(beg, end, cmp);
+inline void intro_sort(Itr beg, Itr end, Comp cmp, PARTITION_KIND kind = PARTITION_KIND::PK_SINGLE_PIVOT, DEPTH_FALLBACK_KIND fallback = DEPTH_FALLBACK_KIND::DFK_HYBRID_STACKLESS_ROTATE_MERGE_SORT,
+					   SMALL_SORT_KIND small = SMALL_SORT_KIND::SSK_MULTI_INSERTION_SORT) {
+	//with the parity merge small partitions are sorted as they are made, otherwise they are all finished with multi_insertion_sort
+	if(small == SMALL_SORT_KIND::SSK_PARITY_MERGE && distance(beg, end) <= INSERTION_SORT_CUTOFF) {
+		stlib_internal::parity_merge_small_sort(beg, end, cmp);
+		return;
+	}
+	if(kind == PARTITION_KIND::PK_DUAL_PIVOT)
+		stlib_internal::dual_pivot_intro_quick_sort_internal(beg, end, cmp, fallback, small);
+	else
+		stlib_internal::adaptive_intro_quick_sort(beg, end, cmp, fallback, small);
 
-	multi_insertion_sort(beg, end, cmp);
+	if(small != SMALL_SORT_KIND::SSK_PARITY_MERGE)
+		multi_insertion_sort(beg, end, cmp);
+}
+
+namespace stlib_internal {
+template<typename Itr, typename IdxItr>
+void stable_nth_element_internal(Itr beg, Itr nth, Itr end, IdxItr begidx) {
+	Itr first = beg;
+	Itr last = end - 1;
+	unsigned depth = get_depth(distance(beg, end));
+	while(distance(first, last + 1) > INSERTION_SORT_CUTOFF) {
+		//no two items have the same index, so finish with an O(n log n) sort that gives the same order as a stable sort
+		if(--depth == 0) {
+			stable_heap_sort(beg, first, last + 1, begidx);
+			return;
+		}
+		Itr pivot = middle_of_three(first, half_point(first, last + 1), last);
+		pivot = stable_intro_partition(beg, first, last + 1, pivot, begidx);
+
+		//only carry on with the side that holds nth
+		if(nth == pivot)
+			return;
+		if(nth < pivot)
+			last = pivot - 1;
+		else
+			first = pivot + 1;
+	}
+	stable_insertion_sort(first, last + 1, begidx + distance(beg, first));
+}
+}
+template<typename Itr>
+void nth_element(Itr beg, Itr nth, Itr end) {
+	//puts the item that would be at nth if the list was sorted there, nothing before it is greater and nothing after it less
+	if(distance(beg, end) <= 1 || nth == end)
+		return;
+	Itr first = beg;
+	Itr last = end - 1;
+	unsigned depth = stlib_internal::get_depth(distance(beg, end));
+	while(distance(first, last + 1) > INSERTION_SORT_CUTOFF) {
+		//do an O(n log n) sort if we have reached the maximum depth
+		if(--depth == 0) {
+			heap_sort(first, last + 1);
+			return;
+		}
+		Itr pivot = stlib_internal::middle_of_three(first, stlib_internal::half_point(first, last + 1), last);
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(first != beg && !stlib_internal::less_func(*(first - 1), *pivot)) {
+			Itr mid = stlib_internal::partition_equal(first, last + 1, pivot);
+			if(nth < mid)
+				return;
+			first = mid;
+			continue;
+		}
+
+		pivot = stlib_internal::intro_partition(first, last + 1, pivot);
+
+		//only carry on with the side that holds nth
+		if(nth == pivot)
+			return;
+		if(nth < pivot)
+			last = pivot - 1;
+		else
+			first = pivot + 1;
+	}
+	multi_insertion_sort(first, last + 1);
+}
+template<typename Itr>
+void stable_nth_element(Itr beg, Itr nth, Itr end) {
+	//as nth_element, but ties are broken by position, so nth gets the item a stable sort would put there and the items
+	//before it are the ones a stable sort would put before it
+	if(distance(beg, end) <= 1 || nth == end)
+		return;
+	std::vector<size_t> idxs;
+	idxs.resize(distance(beg, end));
+	for(size_t i = 0; i < idxs.size(); ++i)
+		idxs[i] = i;
+	stlib_internal::stable_nth_element_internal(beg, nth, end, idxs.begin());
+}
+namespace stlib_internal {
+template<typename Itr, typename IdxItr, typename Comp>
+void stable_nth_element_internal(Itr beg, Itr nth, Itr end, IdxItr begidx, Comp cmp) {
+	Itr first = beg;
+	Itr last = end - 1;
+	unsigned depth = get_depth(distance(beg, end));
+	while(distance(first, last + 1) > INSERTION_SORT_CUTOFF) {
+		//no two items have the same index, so finish with an O(n log n) sort that gives the same order as a stable sort
+		if(--depth == 0) {
+			stable_heap_sort(beg, first, last + 1, begidx, cmp);
+			return;
+		}
+		Itr pivot = middle_of_three(first, half_point(first, last + 1), last, cmp);
+		pivot = stable_intro_partition(beg, first, last + 1, pivot, begidx, cmp);
+
+		//only carry on with the side that holds nth
+		if(nth == pivot)
+			return;
+		if(nth < pivot)
+			last = pivot - 1;
+		else
+			first = pivot + 1;
+	}
+	stable_insertion_sort(first, last + 1, begidx + distance(beg, first), cmp);
+}
+}
+template<typename Itr, typename Comp>
+void nth_element(Itr beg, Itr nth, Itr end, Comp cmp) {
+	//puts the item that would be at nth if the list was sorted there, nothing before it is greater and nothing after it less
+	if(distance(beg, end) <= 1 || nth == end)
+		return;
+	Itr first = beg;
+	Itr last = end - 1;
+	unsigned depth = stlib_internal::get_depth(distance(beg, end));
+	while(distance(first, last + 1) > INSERTION_SORT_CUTOFF) {
+		//do an O(n log n) sort if we have reached the maximum depth
+		if(--depth == 0) {
+			heap_sort(first, last + 1, cmp);
+			return;
+		}
+		Itr pivot = stlib_internal::middle_of_three(first, stlib_internal::half_point(first, last + 1), last, cmp);
+		//the item before this partition is no greater than anything in it, if it is equal to the pivot then every item equal to
+		//the pivot is already in place, group them on the left in one pass and only carry on with the rest
+		if(first != beg && !stlib_internal::less_func(*(first - 1), *pivot, cmp)) {
+			Itr mid = stlib_internal::partition_equal(first, last + 1, pivot, cmp);
+			if(nth < mid)
+				return;
+			first = mid;
+			continue;
+		}
+
+		pivot = stlib_internal::intro_partition(first, last + 1, pivot, cmp);
+
+		//only carry on with the side that holds nth
+		if(nth == pivot)
+			return;
+		if(nth < pivot)
+			last = pivot - 1;
+		else
+			first = pivot + 1;
+	}
+	multi_insertion_sort(first, last + 1, cmp);
+}
+template<typename Itr, typename Comp>
+void stable_nth_element(Itr beg, Itr nth, Itr end, Comp cmp) {
+	//as nth_element, but ties are broken by position, so nth gets the item a stable sort would put there and the items
+	//before it are the ones a stable sort would put before it
+	if(distance(beg, end) <= 1 || nth == end)
+		return;
+	std::vector<size_t> idxs;
+	idxs.resize(distance(beg, end));
+	for(size_t i = 0; i < idxs.size(); ++i)
+		idxs[i] = i;
+	stlib_internal::stable_nth_element_internal(beg, nth, end, idxs.begin(), cmp);
 }
 
 template<typename Itr>
@@ -5643,15 +8538,1293 @@ template<typename Itr, typename Comp>
 inline void stable_sort(Itr beg, Itr end, Comp cmp) {
 	hybrid_merge_sort(beg, end, cmp);
 }
+
 template<typename Itr>
-inline void sort(Itr beg, Itr end) {
+void stable_partial_sort(Itr beg, Itr mid, Itr end) {
+	//sorts the smallest distance(beg, mid) items into [beg, mid) in stable order, the rest are left in [mid, end) in no particular order
+	uint64_t sze = distance(beg, mid);
+	if(sze == 0)
+		return;
+	//keeping a large part of the list, sorting all of it is quicker
+	if(sze > (uint64_t)distance(beg, end) / STABLE_PARTIAL_SORT_FULL_SORT_RATIO) {
+		if(!stlib::hybrid_merge_sort(beg, end))
+			stlib::hybrid_stackless_rotate_merge_sort(beg, end);
+		return;
+	}
+	if(!stlib::hybrid_merge_sort(beg, mid))
+		stlib::hybrid_stackless_rotate_merge_sort(beg, mid);
+
+	if(sze <= INSERTION_SORT_CUTOFF) {
+		//few items are kept, insert each smaller item straight into place replacing the largest
+		for(Itr crnt = mid; crnt != end; ++crnt) {
+			//an item equal to the largest kept item comes after it in the list so doesn't replace it
+			if(!stlib_internal::less_func(*crnt, *(mid - 1)))
+				continue;
+			std::swap(*crnt, *(mid - 1));
+			Itr pos = stlib_internal::exponential_search_upper(beg, mid - 1, *(mid - 1));
+			stlib_internal::rotate(pos, mid - 1, mid);
+		}
+		return;
+	}
+
+	//gather the items less than the largest kept item just after mid (in the order they are found), each time there are as
+	//many as are kept sort them and merge them with the kept items, the kept items come first so equal items stay in order
+	//O(n log k) comparisons as only k log k work is done for each k items that are gathered
+	Itr gathered = mid;
+	for(Itr crnt = mid; crnt != end; ++crnt) {
+		if(!stlib_internal::less_func(*crnt, *(mid - 1)))
+			continue;
+		if(crnt != gathered)
+			std::swap(*crnt, *gathered);
+		++gathered;
+		if((uint64_t)distance(mid, gathered) == sze) {
+			if(!stlib::hybrid_merge_sort(mid, gathered))
+				stlib::hybrid_stackless_rotate_merge_sort(mid, gathered);
+			stlib_internal::rotate_merge(beg, mid, gathered);
+			gathered = mid;
+		}
+	}
+	if(gathered != mid) {
+		if(!stlib::hybrid_merge_sort(mid, gathered))
+			stlib::hybrid_stackless_rotate_merge_sort(mid, gathered);
+		stlib_internal::rotate_merge(beg, mid, gathered);
+	}
+}
+template<typename Itr, typename Comp>
+void stable_partial_sort(Itr beg, Itr mid, Itr end, Comp cmp) {
+	//sorts the smallest distance(beg, mid) items into [beg, mid) in stable order, the rest are left in [mid, end) in no particular order
+	uint64_t sze = distance(beg, mid);
+	if(sze == 0)
+		return;
+	//keeping a large part of the list, sorting all of it is quicker
+	if(sze > (uint64_t)distance(beg, end) / STABLE_PARTIAL_SORT_FULL_SORT_RATIO) {
+		if(!stlib::hybrid_merge_sort(beg, end, cmp))
+			stlib::hybrid_stackless_rotate_merge_sort(beg, end, cmp);
+		return;
+	}
+	if(!stlib::hybrid_merge_sort(beg, mid, cmp))
+		stlib::hybrid_stackless_rotate_merge_sort(beg, mid, cmp);
+
+	if(sze <= INSERTION_SORT_CUTOFF) {
+		//few items are kept, insert each smaller item straight into place replacing the largest
+		for(Itr crnt = mid; crnt != end; ++crnt) {
+			//an item equal to the largest kept item comes after it in the list so doesn't replace it
+			if(!stlib_internal::less_func(*crnt, *(mid - 1), cmp))
+				continue;
+			std::swap(*crnt, *(mid - 1));
+			Itr pos = stlib_internal::exponential_search_upper(beg, mid - 1, *(mid - 1), cmp);
+			stlib_internal::rotate(pos, mid - 1, mid);
+		}
+		return;
+	}
+
+	//gather the items less than the largest kept item just after mid (in the order they are found), each time there are as
+	//many as are kept sort them and merge them with the kept items, the kept items come first so equal items stay in order
+	//O(n log k) comparisons as only k log k work is done for each k items that are gathered
+	Itr gathered = mid;
+	for(Itr crnt = mid; crnt != end; ++crnt) {
+		if(!stlib_internal::less_func(*crnt, *(mid - 1), cmp))
+			continue;
+		if(crnt != gathered)
+			std::swap(*crnt, *gathered);
+		++gathered;
+		if((uint64_t)distance(mid, gathered) == sze) {
+			if(!stlib::hybrid_merge_sort(mid, gathered, cmp))
+				stlib::hybrid_stackless_rotate_merge_sort(mid, gathered, cmp);
+			stlib_internal::rotate_merge(beg, mid, gathered, cmp);
+			gathered = mid;
+		}
+	}
+	if(gathered != mid) {
+		if(!stlib::hybrid_merge_sort(mid, gathered, cmp))
+			stlib::hybrid_stackless_rotate_merge_sort(mid, gathered, cmp);
+		stlib_internal::rotate_merge(beg, mid, gathered, cmp);
+	}
+}
+
+template<typename Itr, typename IdxItr>
+void argsort(Itr beg, Itr end, IdxItr begidx) {
+	//fills [begidx, begidx + distance(beg, end)) with the positions of the items in sorted order, the items themselves are
+	//only compared (never moved) so this suits large items, equal items can be in any order
+	using idxof = typename stlib_internal::value_for<IdxItr>::value_type;
+	uint64_t sze = distance(beg, end);
+	for(uint64_t i = 0; i < sze; ++i)
+		*(begidx + i) = (idxof)i;
+	intro_sort(begidx, begidx + sze, [beg](const idxof& lhs, const idxof& rhs) {
+		return stlib_internal::less_func(*(beg + lhs), *(beg + rhs));
+	});
+}
+template<typename Itr, typename IdxItr>
+void stable_argsort(Itr beg, Itr end, IdxItr begidx) {
+	//as argsort, but equal items keep their order, ties are broken by position as with stable_quick_sort, the order is
+	//then total so no buffer is needed
+	using idxof = typename stlib_internal::value_for<IdxItr>::value_type;
+	uint64_t sze = distance(beg, end);
+	for(uint64_t i = 0; i < sze; ++i)
+		*(begidx + i) = (idxof)i;
+	intro_sort(begidx, begidx + sze, [beg](const idxof& lhs, const idxof& rhs) {
+		if(stlib_internal::less_func(*(beg + lhs), *(beg + rhs)))
+			return true;
+		if(stlib_internal::greater_func(*(beg + lhs), *(beg + rhs)))
+			return false;
+		return lhs < rhs;
+	});
+}
+template<typename Itr, typename IdxItr, typename Comp>
+void argsort(Itr beg, Itr end, IdxItr begidx, Comp cmp) {
+	//fills [begidx, begidx + distance(beg, end)) with the positions of the items in sorted order, the items themselves are
+	//only compared (never moved) so this suits large items, equal items can be in any order
+	using idxof = typename stlib_internal::value_for<IdxItr>::value_type;
+	uint64_t sze = distance(beg, end);
+	for(uint64_t i = 0; i < sze; ++i)
+		*(begidx + i) = (idxof)i;
+	intro_sort(begidx, begidx + sze, [beg, cmp](const idxof& lhs, const idxof& rhs) {
+		return stlib_internal::less_func(*(beg + lhs), *(beg + rhs), cmp);
+	});
+}
+template<typename Itr, typename IdxItr, typename Comp>
+void stable_argsort(Itr beg, Itr end, IdxItr begidx, Comp cmp) {
+	//as argsort, but equal items keep their order, ties are broken by position as with stable_quick_sort, the order is
+	//then total so no buffer is needed
+	using idxof = typename stlib_internal::value_for<IdxItr>::value_type;
+	uint64_t sze = distance(beg, end);
+	for(uint64_t i = 0; i < sze; ++i)
+		*(begidx + i) = (idxof)i;
+	intro_sort(begidx, begidx + sze, [beg, cmp](const idxof& lhs, const idxof& rhs) {
+		if(stlib_internal::less_func(*(beg + lhs), *(beg + rhs), cmp))
+			return true;
+		if(stlib_internal::greater_func(*(beg + lhs), *(beg + rhs), cmp))
+			return false;
+		return lhs < rhs;
+	});
+}
+
+namespace stlib_internal {
+template<typename Func>
+void sample_sort_parallel(unsigned threads, Func func) {
+	//run func(0) to func(threads - 1), one on this thread and the rest on their own threads
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for(unsigned t = 1; t < threads; ++t)
+		workers.push_back(std::thread(func, t));
+	func(0);
+	for(auto& wrk : workers)
+		wrk.join();
+}
+inline unsigned sample_sort_threads(int threads, uint64_t sze) {
+	//zero or less means one per hardware thread
+	unsigned count = threads > 0 ? (unsigned)threads : std::thread::hardware_concurrency();
+	//give each thread atleast a cutoff worth of items
+	uint64_t most = sze / SAMPLE_SORT_CUTOFF;
+	if(count > most)
+		count = (unsigned)most;
+	return count == 0 ? 1 : count;
+}
+template<typename Itr>
+bool sample_sort_internal(Itr beg, Itr end, bool stable, unsigned threads) {
+	using valueof = typename value_for<Itr>::value_type;
+	constexpr unsigned buckets = 1 << SAMPLE_SORT_BUCKET_BITS;
+	uint64_t sze = distance(beg, end);
+
+	//take oversampled splitters, each sample is the middle of three neighbouring items so that patterns in the input don't skew them
+	std::vector<valueof> smp;
+	smp.reserve(buckets * SAMPLE_SORT_OVERSAMPLE);
+	uint64_t step = sze / (buckets * SAMPLE_SORT_OVERSAMPLE);
+	for(uint64_t i = 0; i < buckets * SAMPLE_SORT_OVERSAMPLE; ++i) {
+		Itr first = beg + i * step;
+		smp.push_back(*middle_of_three(first, first + step / 2, first + (step - 1)));
+	}
+	intro_sort(smp.begin(), smp.end());
+
+	//there is no bucket for items equal to a splitter, so with many equal keys they all land in one bucket and that bucket is sorted by one thread
+	//lay the splitters out as an implicit binary tree (children of node j are 2j and 2j + 1), walking it needs no branches
+	std::vector<valueof> tree;
+	tree.reserve(buckets);
+	tree.push_back(smp[0]);
+	for(unsigned depth = 0; depth < SAMPLE_SORT_BUCKET_BITS; ++depth)
+		for(unsigned pos = 0; pos < (1u << depth); ++pos)
+			tree.push_back(smp[((2 * pos + 1) * (buckets >> (depth + 1))) * SAMPLE_SORT_OVERSAMPLE]);
+
+	valueof* buf = (valueof*)aligned_storage_new(sze * sizeof(valueof));
+	if(!buf)
+		return false;
+	std::vector<uint8_t> bucket_of(sze);
+	std::vector<uint64_t> counts(threads * buckets, 0);
+
+	//each thread finds the bucket of every item in its own part of the list
+	sample_sort_parallel(threads, [&](unsigned t) {
+		uint64_t* cnt = &counts[t * buckets];
+		for(uint64_t i = sze * t / threads; i < sze * (t + 1) / threads; ++i) {
+			size_t node = 1;
+			for(unsigned depth = 0; depth < SAMPLE_SORT_BUCKET_BITS; ++depth)
+				node = 2 * node + less_func(tree[node], *(beg + i));
+			bucket_of[i] = (uint8_t)(node - buckets);
+			++cnt[node - buckets];
+		}
+	});
+
+	//where each bucket starts, and where each thread starts in each bucket (in order of the threads, so this is stable)
+	std::vector<uint64_t> bucket_beg(buckets + 1, 0);
+	uint64_t total = 0;
+	for(unsigned b = 0; b < buckets; ++b) {
+		bucket_beg[b] = total;
+		for(unsigned t = 0; t < threads; ++t) {
+			uint64_t cnt = counts[t * buckets + b];
+			counts[t * buckets + b] = total;
+			total += cnt;
+		}
+	}
+	bucket_beg[buckets] = total;
+
+	//move every item into its bucket in the buffer
+	sample_sort_parallel(threads, [&](unsigned t) {
+		uint64_t* offs = &counts[t * buckets];
+		for(uint64_t i = sze * t / threads; i < sze * (t + 1) / threads; ++i)
+			construct(buf[offs[bucket_of[i]]++], std::move(*(beg + i)));
+	});
+
+	//move each bucket back and sort it, the buckets are handed out as the threads finish them
+	std::atomic<unsigned> next(0);
+	sample_sort_parallel(threads, [&](unsigned) {
+		for(unsigned b = next++; b < buckets; b = next++) {
+			for(uint64_t i = bucket_beg[b]; i < bucket_beg[b + 1]; ++i) {
+				*(beg + i) = std::move(buf[i]);
+				destruct(buf[i]);
+			}
+			if(stable)
+				hybrid_stackless_rotate_merge_sort(beg + bucket_beg[b], beg + bucket_beg[b + 1]);
+			else
+				intro_sort(beg + bucket_beg[b], beg + bucket_beg[b + 1]);
+		}
+	});
+
+	aligned_storage_delete(sze * sizeof(valueof), buf);
+	return true;
+}
+template<typename Itr, typename Comp>
+bool sample_sort_internal(Itr beg, Itr end, bool stable, unsigned threads, Comp cmp) {
+	using valueof = typename value_for<Itr>::value_type;
+	constexpr unsigned buckets = 1 << SAMPLE_SORT_BUCKET_BITS;
+	uint64_t sze = distance(beg, end);
+
+	//take oversampled splitters, each sample is the middle of three neighbouring items so that patterns in the input don't skew them
+	std::vector<valueof> smp;
+	smp.reserve(buckets * SAMPLE_SORT_OVERSAMPLE);
+	uint64_t step = sze / (buckets * SAMPLE_SORT_OVERSAMPLE);
+	for(uint64_t i = 0; i < buckets * SAMPLE_SORT_OVERSAMPLE; ++i) {
+		Itr first = beg + i * step;
+		smp.push_back(*middle_of_three(first, first + step / 2, first + (step - 1), cmp));
+	}
+	intro_sort(smp.begin(), smp.end(), cmp);
+
+	//there is no bucket for items equal to a splitter, so with many equal keys they all land in one bucket and that bucket is sorted by one thread
+	//lay the splitters out as an implicit binary tree (children of node j are 2j and 2j + 1), walking it needs no branches
+	std::vector<valueof> tree;
+	tree.reserve(buckets);
+	tree.push_back(smp[0]);
+	for(unsigned depth = 0; depth < SAMPLE_SORT_BUCKET_BITS; ++depth)
+		for(unsigned pos = 0; pos < (1u << depth); ++pos)
+			tree.push_back(smp[((2 * pos + 1) * (buckets >> (depth + 1))) * SAMPLE_SORT_OVERSAMPLE]);
+
+	valueof* buf = (valueof*)aligned_storage_new(sze * sizeof(valueof));
+	if(!buf)
+		return false;
+	std::vector<uint8_t> bucket_of(sze);
+	std::vector<uint64_t> counts(threads * buckets, 0);
+
+	//each thread finds the bucket of every item in its own part of the list
+	sample_sort_parallel(threads, [&](unsigned t) {
+		uint64_t* cnt = &counts[t * buckets];
+		for(uint64_t i = sze * t / threads; i < sze * (t + 1) / threads; ++i) {
+			size_t node = 1;
+			for(unsigned depth = 0; depth < SAMPLE_SORT_BUCKET_BITS; ++depth)
+				node = 2 * node + less_func(tree[node], *(beg + i), cmp);
+			bucket_of[i] = (uint8_t)(node - buckets);
+			++cnt[node - buckets];
+		}
+	});
+
+	//where each bucket starts, and where each thread starts in each bucket (in order of the threads, so this is stable)
+	std::vector<uint64_t> bucket_beg(buckets + 1, 0);
+	uint64_t total = 0;
+	for(unsigned b = 0; b < buckets; ++b) {
+		bucket_beg[b] = total;
+		for(unsigned t = 0; t < threads; ++t) {
+			uint64_t cnt = counts[t * buckets + b];
+			counts[t * buckets + b] = total;
+			total += cnt;
+		}
+	}
+	bucket_beg[buckets] = total;
+
+	//move every item into its bucket in the buffer
+	sample_sort_parallel(threads, [&](unsigned t) {
+		uint64_t* offs = &counts[t * buckets];
+		for(uint64_t i = sze * t / threads; i < sze * (t + 1) / threads; ++i)
+			construct(buf[offs[bucket_of[i]]++], std::move(*(beg + i)));
+	});
+
+	//move each bucket back and sort it, the buckets are handed out as the threads finish them
+	std::atomic<unsigned> next(0);
+	sample_sort_parallel(threads, [&](unsigned) {
+		for(unsigned b = next++; b < buckets; b = next++) {
+			for(uint64_t i = bucket_beg[b]; i < bucket_beg[b + 1]; ++i) {
+				*(beg + i) = std::move(buf[i]);
+				destruct(buf[i]);
+			}
+			if(stable)
+				hybrid_stackless_rotate_merge_sort(beg + bucket_beg[b], beg + bucket_beg[b + 1], cmp);
+			else
+				intro_sort(beg + bucket_beg[b], beg + bucket_beg[b + 1], cmp);
+		}
+	});
+
+	aligned_storage_delete(sze * sizeof(valueof), buf);
+	return true;
+}
+}
+template<typename Itr>
+bool sample_sort(Itr beg, Itr end, bool stable = false, int threads = 0) {
+	uint64_t sze = distance(beg, end);
+	unsigned count = stlib_internal::sample_sort_threads(threads, sze);
+	if(sze < SAMPLE_SORT_CUTOFF || count == 1) {
+		//not worth splitting up
+		if(stable)
+			hybrid_stackless_rotate_merge_sort(beg, end);
+		else
+			intro_sort(beg, end);
+		return true;
+	}
+	return stlib_internal::sample_sort_internal(beg, end, stable, count);
+}
+template<typename Itr, typename Comp>
+bool sample_sort(Itr beg, Itr end, Comp cmp, bool stable = false, int threads = 0) {
+	uint64_t sze = distance(beg, end);
+	unsigned count = stlib_internal::sample_sort_threads(threads, sze);
+	if(sze < SAMPLE_SORT_CUTOFF || count == 1) {
+		//not worth splitting up
+		if(stable)
+			hybrid_stackless_rotate_merge_sort(beg, end, cmp);
+		else
+			intro_sort(beg, end, cmp);
+		return true;
+	}
+	return stlib_internal::sample_sort_internal(beg, end, stable, count, cmp);
+}
+template<typename Itr, typename IdxItr>
+void apply_permutation(Itr beg, Itr end, IdxItr begidx) {
+	//moves the items so that the item at position i is the one that was at position begidx[i] (as given by argsort), each
+	//cycle of the permutation is followed from its first position so every item is moved once, and visited indexes are
+	//marked with their top bit (which must be clear) and unmarked at the end so the index array is left as it was
+	using idxof = typename stlib_internal::value_for<IdxItr>::value_type;
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	const idxof mark = (idxof)1 << (sizeof(idxof) * 8 - 1);
+	uint64_t sze = distance(beg, end);
+	for(uint64_t i = 0; i < sze; ++i) {
+		if((*(begidx + i) & mark) != 0)
+			continue;
+		//already in place
+		if((uint64_t)*(begidx + i) == i) {
+			*(begidx + i) |= mark;
+			continue;
+		}
+		valueof tmp = std::move(*(beg + i));
+		uint64_t crnt = i;
+		for(;;) {
+			uint64_t next = *(begidx + crnt);
+			*(begidx + crnt) |= mark;
+			if(next == i)
+				break;
+			*(beg + crnt) = std::move(*(beg + next));
+			crnt = next;
+		}
+		*(beg + crnt) = std::move(tmp);
+	}
+	for(uint64_t i = 0; i < sze; ++i)
+		*(begidx + i) &= ~mark;
+}
+template<typename Itr, typename IdxItr>
+void apply_permutation_parallel(Itr beg, Itr end, IdxItr begidx, int threads = 0) {
+	//as apply_permutation but each thread gathers its own part of the list into a buffer then moves it back, this needs a
+	//buffer the size of the list but no marks, if the buffer can't be allocated (or the list is short) apply_permutation is used
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	uint64_t sze = distance(beg, end);
+	unsigned count = stlib_internal::sample_sort_threads(threads, sze);
+	valueof* buf = nullptr;
+	if(sze >= SAMPLE_SORT_CUTOFF && count > 1)
+		buf = (valueof*)stlib_internal::aligned_storage_new(sze * sizeof(valueof));
+	if(!buf) {
+		apply_permutation(beg, end, begidx);
+		return;
+	}
+
+	//every item is read from once, so the threads never move the same item
+	stlib_internal::sample_sort_parallel(count, [&](unsigned t) {
+		for(uint64_t i = sze * t / count; i < sze * (t + 1) / count; ++i)
+			stlib_internal::construct(buf[i], std::move(*(beg + *(begidx + i))));
+	});
+	stlib_internal::sample_sort_parallel(count, [&](unsigned t) {
+		for(uint64_t i = sze * t / count; i < sze * (t + 1) / count; ++i) {
+			*(beg + i) = std::move(buf[i]);
+			stlib_internal::destruct(buf[i]);
+		}
+	});
+
+	stlib_internal::aligned_storage_delete(sze * sizeof(valueof), buf);
+}
+namespace stlib_internal {
+template<typename Itr>
+struct use_radix_sort {
+	//integers, float and double (but not bool) can be sorted by their bits
+	using valueof = typename std::remove_cv<typename value_for<Itr>::value_type>::type;
+	static constexpr bool value = std::is_arithmetic<valueof>::value &&
+								  !std::is_same<valueof, bool>::value &&
+								  sizeof(valueof) <= sizeof(uint64_t);
+};
+template<typename Itr>
+void sort_internal(Itr beg, Itr end, std::false_type) {
 	intro_sort(beg, end);
 }
+template<typename Itr>
+void sort_internal(Itr beg, Itr end, std::true_type) {
+	//the bucket counting isn't worth it for short lists
+	if(distance(beg, end) >= SORT_RADIX_CUTOFF)
+		american_flag_sort(beg, end);
+	else
+		intro_sort(beg, end);
+}
+}
+template<typename Itr>
+inline void sort(Itr beg, Itr end) {
+	stlib_internal::sort_internal(beg, end, std::integral_constant<bool, stlib_internal::use_radix_sort<Itr>::value>());
+}
 template<typename Itr, typename Comp>
 inline void sort(Itr beg, Itr end, Comp cmp) {
 	intro_sort(beg, end, cmp);
 }
 
+namespace stlib_internal {
+template<typename T>
+struct is_iterator {
+	//pointers and anything with an iterator_category, so a list can be told apart from a compare function
+	template<typename U>
+	static std::true_type test(typename std::iterator_traits<U>::iterator_category*);
+	template<typename U>
+	static std::false_type test(...);
+	static constexpr bool value = decltype(test<T>(nullptr))::value;
+};
+template<typename IdxItr>
+void apply_permutation_each(uint64_t, IdxItr) {
+}
+template<typename IdxItr, typename Itr, typename... Itrs>
+void apply_permutation_each(uint64_t sze, IdxItr begidx, Itr beg, Itrs... begs) {
+	stlib::apply_permutation(beg, beg + sze, begidx);
+	apply_permutation_each(sze, begidx, begs...);
+}
+template<typename K, typename Idx>
+struct keyed_index {
+	K key;
+	Idx idx;
+};
+struct keyed_index_key {
+	template<typename K, typename Idx>
+	const K& operator()(const keyed_index<K, Idx>& item) const {
+		return item.key;
+	}
+};
+template<typename K, typename Idx>
+void sort_keyed(bool stable, std::vector<keyed_index<K, Idx>>& keyed, std::false_type) {
+	if(stable) {
+		//merge sort makes the fewest compares, if the buffer can't be allocated break ties by position so the order is total
+		if(hybrid_merge_sort(keyed.begin(), keyed.end(), [](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			return less_func(lhs.key, rhs.key);
+		}))
+			return;
+		intro_sort(keyed.begin(), keyed.end(), [](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			if(less_func(lhs.key, rhs.key))
+				return true;
+			if(greater_func(lhs.key, rhs.key))
+				return false;
+			return lhs.idx < rhs.idx;
+		});
+	} else {
+		intro_sort(keyed.begin(), keyed.end(), [](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			return less_func(lhs.key, rhs.key);
+		});
+	}
+}
+template<typename K, typename Idx>
+void sort_keyed(bool stable, std::vector<keyed_index<K, Idx>>& keyed, std::true_type) {
+	//integer and floating point keys are sorted by their bits, radix_sort is stable
+	if(distance(keyed.begin(), keyed.end()) < SORT_RADIX_CUTOFF)
+		sort_keyed(stable, keyed, std::false_type());
+	else if(!stable)
+		american_flag_sort(keyed.begin(), keyed.end(), keyed_index_key());
+	else if(!radix_sort(keyed.begin(), keyed.end(), keyed_index_key()))
+		sort_keyed(stable, keyed, std::false_type());
+}
+template<typename K, typename Idx, typename Comp>
+void sort_keyed(bool stable, std::vector<keyed_index<K, Idx>>& keyed, Comp cmp) {
+	if(stable) {
+		//merge sort makes the fewest compares, if the buffer can't be allocated break ties by position so the order is total
+		if(hybrid_merge_sort(keyed.begin(), keyed.end(), [cmp](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			return less_func(lhs.key, rhs.key, cmp);
+		}))
+			return;
+		intro_sort(keyed.begin(), keyed.end(), [cmp](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			if(less_func(lhs.key, rhs.key, cmp))
+				return true;
+			if(greater_func(lhs.key, rhs.key, cmp))
+				return false;
+			return lhs.idx < rhs.idx;
+		});
+	} else {
+		intro_sort(keyed.begin(), keyed.end(), [cmp](const keyed_index<K, Idx>& lhs, const keyed_index<K, Idx>& rhs) {
+			return less_func(lhs.key, rhs.key, cmp);
+		});
+	}
+}
+template<typename K, typename Idx, typename... Itrs>
+void apply_keyed(std::vector<keyed_index<K, Idx>>& keyed, Itrs... begs) {
+	//move every list into the order of the sorted positions
+	std::vector<Idx> idxs(keyed.size());
+	for(size_t i = 0; i < keyed.size(); ++i)
+		idxs[i] = keyed[i].idx;
+	std::vector<keyed_index<K, Idx>>().swap(keyed);
+	apply_permutation_each(idxs.size(), idxs.begin(), begs...);
+}
+template<typename Idx, typename KeyItr, typename... Itrs>
+void sort_by_key_internal(bool stable, KeyItr kbeg, KeyItr kend, std::true_type, Itrs... begs) {
+	using keyof = typename value_for<KeyItr>::value_type;
+	uint64_t sze = distance(kbeg, kend);
+	//the keys are moved next to their position and sorted together, so the sort doesn't jump around the key list
+	std::vector<keyed_index<keyof, Idx>> keyed;
+	keyed.reserve(sze);
+	for(uint64_t i = 0; i < sze; ++i)
+		keyed.push_back({std::move(*(kbeg + i)), (Idx)i});
+	sort_keyed(stable, keyed, std::integral_constant<bool, use_radix_sort<KeyItr>::value>());
+
+	//move the keys back then every value list into the same order
+	for(uint64_t i = 0; i < sze; ++i)
+		*(kbeg + i) = std::move(keyed[i].key);
+	apply_keyed(keyed, begs...);
+}
+template<typename Idx, typename KeyItr, typename Comp, typename... Itrs>
+void sort_by_key_internal(bool stable, KeyItr kbeg, KeyItr kend, std::false_type, Comp cmp, Itrs... begs) {
+	using keyof = typename value_for<KeyItr>::value_type;
+	uint64_t sze = distance(kbeg, kend);
+	//the keys are moved next to their position and sorted together, so the sort doesn't jump around the key list
+	std::vector<keyed_index<keyof, Idx>> keyed;
+	keyed.reserve(sze);
+	for(uint64_t i = 0; i < sze; ++i)
+		keyed.push_back({std::move(*(kbeg + i)), (Idx)i});
+	sort_keyed(stable, keyed, cmp);
+
+	//move the keys back then every value list into the same order
+	for(uint64_t i = 0; i < sze; ++i)
+		*(kbeg + i) = std::move(keyed[i].key);
+	apply_keyed(keyed, begs...);
+}
+template<typename Idx, typename Itr, typename KeyFunc>
+void sort_by_internal(bool stable, Itr beg, Itr end, KeyFunc keyfunc) {
+	using keyof = typename std::decay<decltype(keyfunc(*beg))>::type;
+	uint64_t sze = distance(beg, end);
+	//each key is worked out once and kept with its position, the items are only moved at the end
+	std::vector<keyed_index<keyof, Idx>> keyed;
+	keyed.reserve(sze);
+	for(uint64_t i = 0; i < sze; ++i)
+		keyed.push_back({keyfunc(*(beg + i)), (Idx)i});
+	sort_keyed(stable, keyed, std::integral_constant<bool, use_radix_sort<keyof*>::value>());
+	apply_keyed(keyed, beg);
+}
+template<typename Idx, typename Itr, typename KeyFunc, typename Comp>
+void sort_by_internal(bool stable, Itr beg, Itr end, KeyFunc keyfunc, Comp cmp) {
+	using keyof = typename std::decay<decltype(keyfunc(*beg))>::type;
+	uint64_t sze = distance(beg, end);
+	//each key is worked out once and kept with its position, the items are only moved at the end
+	std::vector<keyed_index<keyof, Idx>> keyed;
+	keyed.reserve(sze);
+	for(uint64_t i = 0; i < sze; ++i)
+		keyed.push_back({keyfunc(*(beg + i)), (Idx)i});
+	sort_keyed(stable, keyed, cmp);
+	apply_keyed(keyed, beg);
+}
+}
+template<typename KeyItr, typename Arg, typename... Itrs>
+void sort_by_key(KeyItr kbeg, KeyItr kend, Arg arg, Itrs... begs) {
+	//sorts the keys and moves the items of one or more value lists (of atleast as many items) in the same way, arg is
+	//either the first value list or a compare function for the keys followed by the value lists
+	//the keys are sorted together with their positions, each list is then moved into order with apply_permutation so every item moves once
+	std::integral_constant<bool, stlib_internal::is_iterator<Arg>::value> tag;
+	//apply_permutation needs the top bit of the index clear
+	if((uint64_t)distance(kbeg, kend) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_key_internal<uint32_t>(false, kbeg, kend, tag, arg, begs...);
+	else
+		stlib_internal::sort_by_key_internal<uint64_t>(false, kbeg, kend, tag, arg, begs...);
+}
+template<typename KeyItr, typename Arg, typename... Itrs>
+void stable_sort_by_key(KeyItr kbeg, KeyItr kend, Arg arg, Itrs... begs) {
+	//as sort_by_key, but items with equal keys keep their order in every list
+	std::integral_constant<bool, stlib_internal::is_iterator<Arg>::value> tag;
+	//apply_permutation needs the top bit of the index clear
+	if((uint64_t)distance(kbeg, kend) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_key_internal<uint32_t>(true, kbeg, kend, tag, arg, begs...);
+	else
+		stlib_internal::sort_by_key_internal<uint64_t>(true, kbeg, kend, tag, arg, begs...);
+}
+template<typename Itr, typename KeyFunc>
+void sort_by(Itr beg, Itr end, KeyFunc keyfunc) {
+	//sorts by keyfunc(item), for when working out the key is costly, each key is worked out once and sorted with its
+	//position (integer and floating point keys with american_flag_sort), then the items are moved into order with apply_permutation
+	//apply_permutation needs the top bit of the index clear
+	if((uint64_t)distance(beg, end) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_internal<uint32_t>(false, beg, end, keyfunc);
+	else
+		stlib_internal::sort_by_internal<uint64_t>(false, beg, end, keyfunc);
+}
+template<typename Itr, typename KeyFunc>
+void stable_sort_by(Itr beg, Itr end, KeyFunc keyfunc) {
+	//as sort_by, but items with equal keys keep their order (integer and floating point keys with radix_sort, otherwise hybrid_merge_sort)
+	if((uint64_t)distance(beg, end) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_internal<uint32_t>(true, beg, end, keyfunc);
+	else
+		stlib_internal::sort_by_internal<uint64_t>(true, beg, end, keyfunc);
+}
+template<typename Itr, typename KeyFunc, typename Comp>
+void sort_by(Itr beg, Itr end, KeyFunc keyfunc, Comp cmp) {
+	//sorts by keyfunc(item) using cmp to compare the keys, each key is worked out once and sorted with its position, then
+	//the items are moved into order with apply_permutation
+	//apply_permutation needs the top bit of the index clear
+	if((uint64_t)distance(beg, end) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_internal<uint32_t>(false, beg, end, keyfunc, cmp);
+	else
+		stlib_internal::sort_by_internal<uint64_t>(false, beg, end, keyfunc, cmp);
+}
+template<typename Itr, typename KeyFunc, typename Comp>
+void stable_sort_by(Itr beg, Itr end, KeyFunc keyfunc, Comp cmp) {
+	//as sort_by, but items with equal keys keep their order
+	if((uint64_t)distance(beg, end) < ((uint64_t)1 << 31))
+		stlib_internal::sort_by_internal<uint32_t>(true, beg, end, keyfunc, cmp);
+	else
+		stlib_internal::sort_by_internal<uint64_t>(true, beg, end, keyfunc, cmp);
+}
+
+//sorts a file of fixed size records by the key_width bytes at key_offset into each record, for files larger than memory
+//chunks of atmost memory_budget bytes are sorted and written to temporary files (in temp_dir, or the directory of out_path if not given)
+//which are then merged, records with equal keys stay in order, returns false if the file can't be read or written
+bool external_sort(const char* in_path, const char* out_path, size_t record_size, size_t key_offset, size_t key_width,
+				   size_t memory_budget, EXTERNAL_SORT_KEY_KIND kind = EXTERNAL_SORT_KEY_KIND::ESKK_BYTES, const char* temp_dir = nullptr);
+
+template<typename T, typename Comp = std::less<T>>
+class sorted_vector {
+	std::vector<T> items;
+	Comp cmp;
+
+	void merge_batch(size_t sze) {
+		//the first sze items are the sorted body and the rest the sorted batch
+		size_t count = items.size() - sze;
+		if(sze == 0 || count == 0 || !stlib_internal::less_func(items[sze], items[sze - 1], cmp))
+			return;
+		T* buf = (T*)stlib_internal::aligned_storage_new(count * sizeof(T));
+		if(!buf) {
+			//no memory to spare, merge in place
+			stlib_internal::rotate_merge(items.begin(), items.begin() + sze, items.end(), cmp);
+			return;
+		}
+		for(size_t i = 0; i < count; ++i)
+			stlib_internal::construct(buf[i], std::move(items[sze + i]));
+
+		//merge from the back, each batch item goes after the body items equal to it, so the body only moves once
+		size_t dst = items.size();
+		size_t rem = sze;
+		for(size_t i = count; i > 0; --i) {
+			size_t pos = distance(items.begin(), stlib_internal::exponential_search_upper(items.begin(), items.begin() + rem, buf[i - 1], cmp));
+			while(rem > pos)
+				items[--dst] = std::move(items[--rem]);
+			items[--dst] = std::move(buf[i - 1]);
+			stlib_internal::destruct(buf[i - 1]);
+		}
+
+		stlib_internal::aligned_storage_delete(count * sizeof(T), buf);
+	}
+public:
+	using value_type = T;
+	using const_iterator = typename std::vector<T>::const_iterator;
+
+	sorted_vector() = default;
+	explicit sorted_vector(Comp comp) : cmp(comp) {}
+
+	//adds a batch of items, they are sorted then merged into the existing items, equal items keep the order they were added in
+	//O(k log N) compares for k items, no full sort
+	template<typename Itr>
+	void insert(Itr beg, Itr end) {
+		size_t sze = items.size();
+		items.insert(items.end(), beg, end);
+		if(items.size() - sze <= INSERTION_SORT_CUTOFF)
+			multi_insertion_sort(items.begin() + sze, items.end(), cmp);
+		else if(!hybrid_merge_sort(items.begin() + sze, items.end(), cmp))
+			hybrid_stackless_rotate_merge_sort(items.begin() + sze, items.end(), cmp);
+		merge_batch(sze);
+	}
+	void insert(const T& item) {
+		items.insert(stlib_internal::exponential_search_upper(items.begin(), items.end(), item, cmp), item);
+	}
+	void insert(T&& item) {
+		items.insert(stlib_internal::exponential_search_upper(items.begin(), items.end(), item, cmp), std::move(item));
+	}
+	const_iterator erase(const_iterator pos) {
+		return items.erase(pos);
+	}
+	const_iterator erase(const_iterator first, const_iterator last) {
+		return items.erase(first, last);
+	}
+
+	//the first item not less than item
+	const_iterator lower_bound(const T& item) const {
+		const_iterator out;
+		binary_search(items.begin(), items.end(), item, cmp, out);
+		return out;
+	}
+	//the first item greater than item
+	const_iterator upper_bound(const T& item) const {
+		return stlib_internal::exponential_search_upper(lower_bound(item), items.end(), item, cmp);
+	}
+	//the items equal to item
+	std::pair<const_iterator, const_iterator> equal_range(const T& item) const {
+		const_iterator first = lower_bound(item);
+		return std::make_pair(first, stlib_internal::exponential_search_upper(first, items.end(), item, cmp));
+	}
+	//the items in [low, high)
+	std::pair<const_iterator, const_iterator> range(const T& low, const T& high) const {
+		const_iterator first = lower_bound(low);
+		const_iterator last;
+		binary_search(first, items.end(), high, cmp, last);
+		return std::make_pair(first, last);
+	}
+	bool contains(const T& item) const {
+		const_iterator out;
+		return binary_search(items.begin(), items.end(), item, cmp, out);
+	}
+
+	const_iterator begin() const {
+		return items.begin();
+	}
+	const_iterator end() const {
+		return items.end();
+	}
+	const T& operator[](size_t idx) const {
+		return items[idx];
+	}
+	size_t size() const {
+		return items.size();
+	}
+	bool empty() const {
+		return items.empty();
+	}
+	void reserve(size_t sze) {
+		items.reserve(sze);
+	}
+	void clear() {
+		items.clear();
+	}
+};
+namespace stlib_internal {
+template<typename Itr>
+inline bool kway_merge_beats(const std::vector<std::pair<Itr, Itr>>& runs, unsigned lhs, unsigned rhs) {
+	//does run lhs win against run rhs (neither is empty), equal items are won by the earlier run so this is stable
+	//if lhs is the earlier run it wins unless rhs is less, otherwise it wins only if it is less, so one compare is enough,
+	//the runs are swapped round with a mask rather than a branch as which is earlier can't be predicted
+	bool earlier = lhs < rhs;
+	unsigned diff = (lhs ^ rhs) & (0u - (unsigned)earlier);
+	return less_func(*runs[lhs ^ diff].first, *runs[rhs ^ diff].first) != earlier;
+}
+template<typename Itr>
+void kway_merge_build(const std::vector<std::pair<Itr, Itr>>& runs, std::vector<unsigned>& tree) {
+	//the runs are the leaves k to 2k - 1, each inner node keeps the run that lost there, node 0 keeps the overall winner
+	unsigned k = (unsigned)runs.size();
+	tree.assign(k, 0);
+	std::vector<unsigned> winner(2 * k);
+	for(unsigned i = 0; i < k; ++i)
+		winner[k + i] = i;
+	for(unsigned node = k - 1; node > 0; --node) {
+		unsigned lhs = winner[2 * node];
+		unsigned rhs = winner[2 * node + 1];
+		if(kway_merge_beats(runs, lhs, rhs)) {
+			winner[node] = lhs;
+			tree[node] = rhs;
+		} else {
+			winner[node] = rhs;
+			tree[node] = lhs;
+		}
+	}
+	tree[0] = winner[1];
+}
+template<typename Itr>
+void kway_merge_replay(const std::vector<std::pair<Itr, Itr>>& runs, std::vector<unsigned>& tree, unsigned win) {
+	//the winner has a new head, replay its matches from its leaf to the root
+	unsigned k = (unsigned)runs.size();
+	for(unsigned node = (win + k) / 2; node > 0; node /= 2) {
+		//swap the winner with the loser kept here if that beats it, again without a branch
+		unsigned other = tree[node];
+		unsigned diff = (other ^ win) & (0u - (unsigned)kway_merge_beats(runs, other, win));
+		tree[node] = other ^ diff;
+		win ^= diff;
+	}
+	tree[0] = win;
+}
+template<typename Itr, typename T>
+void buffered_merge(Itr beg1, Itr beg2, Itr end2, T* buf, uint64_t bufsze) {
+	//merge two neighbouring lists using a buffer of bufsze items, while neither list fits in the buffer split them in two
+	//around the middle of the longer list and rotate the middle parts past each other (as sym_merge)
+	for(;;) {
+		uint64_t sze1 = distance(beg1, beg2);
+		uint64_t sze2 = distance(beg2, end2);
+		if(sze1 == 0 || sze2 == 0 || !less_func(*beg2, *(beg2 - 1)))
+			return;
+		if(sze1 <= bufsze) {
+			//move the left list out and merge forwards
+			for(uint64_t i = 0; i < sze1; ++i)
+				construct(buf[i], std::move(*(beg1 + i)));
+			T* left = buf;
+			T* left_end = buf + sze1;
+			Itr out = beg1;
+			while(left != left_end && beg2 != end2) {
+				if(less_func(*beg2, *left))
+					*out++ = std::move(*beg2++);
+				else
+					*out++ = std::move(*left++);
+			}
+			while(left != left_end)
+				*out++ = std::move(*left++);
+			for(uint64_t i = 0; i < sze1; ++i)
+				destruct(buf[i]);
+			return;
+		}
+		if(sze2 <= bufsze) {
+			//move the right list out and merge backwards
+			for(uint64_t i = 0; i < sze2; ++i)
+				construct(buf[i], std::move(*(beg2 + i)));
+			T* right = buf + sze2;
+			Itr left = beg2;
+			Itr out = end2;
+			while(right != buf && left != beg1) {
+				if(less_func(*(right - 1), *(left - 1)))
+					*--out = std::move(*--left);
+				else
+					*--out = std::move(*--right);
+			}
+			while(right != buf)
+				*--out = std::move(*--right);
+			for(uint64_t i = 0; i < sze2; ++i)
+				destruct(buf[i]);
+			return;
+		}
+
+		//the items of the right list before cut1 are those less than it, the items of the left list before cut2 are those not greater
+		Itr cut1;
+		Itr cut2;
+		if(sze1 >= sze2) {
+			cut1 = beg1 + sze1 / 2;
+			binary_search(beg2, end2, *cut1, cut2);
+		} else {
+			cut2 = beg2 + sze2 / 2;
+			cut1 = exponential_search_upper(beg1, beg2, *cut2);
+		}
+		stlib_internal::rotate(cut1, beg2, cut2);
+		Itr mid = cut1 + distance(beg2, cut2);
+		//recurse into the smaller half, loop on the larger
+		if(distance(beg1, mid) < distance(mid, end2)) {
+			buffered_merge(beg1, cut1, mid, buf, bufsze);
+			beg1 = mid;
+			beg2 = cut2;
+		} else {
+			buffered_merge(mid, cut2, end2, buf, bufsze);
+			beg2 = cut1;
+			end2 = mid;
+		}
+	}
+}
+}
+template<typename Itr, typename OutItr>
+OutItr kway_merge(const std::vector<std::pair<Itr, Itr>>& runs, OutItr out) {
+	//moves the items of k sorted runs into out in sorted order, returns the end of the output
+	//a loser tree picks the next item in log k compares, equal items come out in the order of their runs then their positions
+	std::vector<std::pair<Itr, Itr>> crnt;
+	for(const auto& run : runs)
+		if(run.first != run.second)
+			crnt.push_back(run);
+
+	//a run that runs out is taken out and the tree built again over the rest (in the same order), so the matches never
+	//have to check for empty runs and each is a single compare
+	std::vector<unsigned> tree;
+	while(crnt.size() > 1) {
+		stlib_internal::kway_merge_build(crnt, tree);
+		for(;;) {
+			unsigned win = tree[0];
+			*out = std::move(*crnt[win].first);
+			++out;
+			if(++crnt[win].first == crnt[win].second) {
+				crnt.erase(crnt.begin() + win);
+				break;
+			}
+			stlib_internal::kway_merge_replay(crnt, tree, win);
+		}
+	}
+	if(!crnt.empty())
+		for(Itr it = crnt[0].first; it != crnt[0].second; ++it, ++out)
+			*out = std::move(*it);
+	return out;
+}
+template<typename Itr>
+void kway_merge_inplace(const std::vector<Itr>& bounds) {
+	//merges the neighbouring sorted runs [bounds[i], bounds[i + 1]) of one list, pairs of runs are merged in rounds so
+	//each item is moved O(log k) times, using a buffer of at most KWAY_MERGE_BUFFER_BYTES (rotate merges if it can't be allocated)
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	if(bounds.size() <= 2)
+		return;
+	uint64_t sze = distance(bounds.front(), bounds.back());
+	uint64_t bufsze = KWAY_MERGE_BUFFER_BYTES / sizeof(valueof);
+	if(bufsze > sze / 2)
+		bufsze = sze / 2;
+	valueof* buf = bufsze > 0 ? (valueof*)stlib_internal::aligned_storage_new(bufsze * sizeof(valueof)) : nullptr;
+	if(!buf)
+		bufsze = 0;
+
+	std::vector<Itr> crnt = bounds;
+	while(crnt.size() > 2) {
+		std::vector<Itr> next;
+		next.reserve(crnt.size() / 2 + 2);
+		size_t i = 0;
+		for(; i + 2 < crnt.size(); i += 2) {
+			next.push_back(crnt[i]);
+			stlib_internal::buffered_merge(crnt[i], crnt[i + 1], crnt[i + 2], buf, bufsze);
+		}
+		//an odd run out is carried to the next round
+		for(; i < crnt.size(); ++i)
+			next.push_back(crnt[i]);
+		crnt.swap(next);
+	}
+
+	if(buf)
+		stlib_internal::aligned_storage_delete(bufsze * sizeof(valueof), buf);
+}
+namespace stlib_internal {
+template<typename Itr, typename Comp>
+inline bool kway_merge_beats(const std::vector<std::pair<Itr, Itr>>& runs, unsigned lhs, unsigned rhs, Comp cmp) {
+	//does run lhs win against run rhs (neither is empty), equal items are won by the earlier run so this is stable
+	//if lhs is the earlier run it wins unless rhs is less, otherwise it wins only if it is less, so one compare is enough,
+	//the runs are swapped round with a mask rather than a branch as which is earlier can't be predicted
+	bool earlier = lhs < rhs;
+	unsigned diff = (lhs ^ rhs) & (0u - (unsigned)earlier);
+	return less_func(*runs[lhs ^ diff].first, *runs[rhs ^ diff].first, cmp) != earlier;
+}
+template<typename Itr, typename Comp>
+void kway_merge_build(const std::vector<std::pair<Itr, Itr>>& runs, std::vector<unsigned>& tree, Comp cmp) {
+	//the runs are the leaves k to 2k - 1, each inner node keeps the run that lost there, node 0 keeps the overall winner
+	unsigned k = (unsigned)runs.size();
+	tree.assign(k, 0);
+	std::vector<unsigned> winner(2 * k);
+	for(unsigned i = 0; i < k; ++i)
+		winner[k + i] = i;
+	for(unsigned node = k - 1; node > 0; --node) {
+		unsigned lhs = winner[2 * node];
+		unsigned rhs = winner[2 * node + 1];
+		if(kway_merge_beats(runs, lhs, rhs, cmp)) {
+			winner[node] = lhs;
+			tree[node] = rhs;
+		} else {
+			winner[node] = rhs;
+			tree[node] = lhs;
+		}
+	}
+	tree[0] = winner[1];
+}
+template<typename Itr, typename Comp>
+void kway_merge_replay(const std::vector<std::pair<Itr, Itr>>& runs, std::vector<unsigned>& tree, unsigned win, Comp cmp) {
+	//the winner has a new head, replay its matches from its leaf to the root
+	unsigned k = (unsigned)runs.size();
+	for(unsigned node = (win + k) / 2; node > 0; node /= 2) {
+		//swap the winner with the loser kept here if that beats it, again without a branch
+		unsigned other = tree[node];
+		unsigned diff = (other ^ win) & (0u - (unsigned)kway_merge_beats(runs, other, win, cmp));
+		tree[node] = other ^ diff;
+		win ^= diff;
+	}
+	tree[0] = win;
+}
+template<typename Itr, typename T, typename Comp>
+void buffered_merge(Itr beg1, Itr beg2, Itr end2, T* buf, uint64_t bufsze, Comp cmp) {
+	//merge two neighbouring lists using a buffer of bufsze items, while neither list fits in the buffer split them in two
+	//around the middle of the longer list and rotate the middle parts past each other (as sym_merge)
+	for(;;) {
+		uint64_t sze1 = distance(beg1, beg2);
+		uint64_t sze2 = distance(beg2, end2);
+		if(sze1 == 0 || sze2 == 0 || !less_func(*beg2, *(beg2 - 1), cmp))
+			return;
+		if(sze1 <= bufsze) {
+			//move the left list out and merge forwards
+			for(uint64_t i = 0; i < sze1; ++i)
+				construct(buf[i], std::move(*(beg1 + i)));
+			T* left = buf;
+			T* left_end = buf + sze1;
+			Itr out = beg1;
+			while(left != left_end && beg2 != end2) {
+				if(less_func(*beg2, *left, cmp))
+					*out++ = std::move(*beg2++);
+				else
+					*out++ = std::move(*left++);
+			}
+			while(left != left_end)
+				*out++ = std::move(*left++);
+			for(uint64_t i = 0; i < sze1; ++i)
+				destruct(buf[i]);
+			return;
+		}
+		if(sze2 <= bufsze) {
+			//move the right list out and merge backwards
+			for(uint64_t i = 0; i < sze2; ++i)
+				construct(buf[i], std::move(*(beg2 + i)));
+			T* right = buf + sze2;
+			Itr left = beg2;
+			Itr out = end2;
+			while(right != buf && left != beg1) {
+				if(less_func(*(right - 1), *(left - 1), cmp))
+					*--out = std::move(*--left);
+				else
+					*--out = std::move(*--right);
+			}
+			while(right != buf)
+				*--out = std::move(*--right);
+			for(uint64_t i = 0; i < sze2; ++i)
+				destruct(buf[i]);
+			return;
+		}
+
+		//the items of the right list before cut1 are those less than it, the items of the left list before cut2 are those not greater
+		Itr cut1;
+		Itr cut2;
+		if(sze1 >= sze2) {
+			cut1 = beg1 + sze1 / 2;
+			binary_search(beg2, end2, *cut1, cmp, cut2);
+		} else {
+			cut2 = beg2 + sze2 / 2;
+			cut1 = exponential_search_upper(beg1, beg2, *cut2, cmp);
+		}
+		stlib_internal::rotate(cut1, beg2, cut2);
+		Itr mid = cut1 + distance(beg2, cut2);
+		//recurse into the smaller half, loop on the larger
+		if(distance(beg1, mid) < distance(mid, end2)) {
+			buffered_merge(beg1, cut1, mid, buf, bufsze, cmp);
+			beg1 = mid;
+			beg2 = cut2;
+		} else {
+			buffered_merge(mid, cut2, end2, buf, bufsze, cmp);
+			beg2 = cut1;
+			end2 = mid;
+		}
+	}
+}
+}
+template<typename Itr, typename OutItr, typename Comp>
+OutItr kway_merge(const std::vector<std::pair<Itr, Itr>>& runs, OutItr out, Comp cmp) {
+	//moves the items of k sorted runs into out in sorted order, returns the end of the output
+	//a loser tree picks the next item in log k compares, equal items come out in the order of their runs then their positions
+	std::vector<std::pair<Itr, Itr>> crnt;
+	for(const auto& run : runs)
+		if(run.first != run.second)
+			crnt.push_back(run);
+
+	//a run that runs out is taken out and the tree built again over the rest (in the same order), so the matches never
+	//have to check for empty runs and each is a single compare
+	std::vector<unsigned> tree;
+	while(crnt.size() > 1) {
+		stlib_internal::kway_merge_build(crnt, tree, cmp);
+		for(;;) {
+			unsigned win = tree[0];
+			*out = std::move(*crnt[win].first);
+			++out;
+			if(++crnt[win].first == crnt[win].second) {
+				crnt.erase(crnt.begin() + win);
+				break;
+			}
+			stlib_internal::kway_merge_replay(crnt, tree, win, cmp);
+		}
+	}
+	if(!crnt.empty())
+		for(Itr it = crnt[0].first; it != crnt[0].second; ++it, ++out)
+			*out = std::move(*it);
+	return out;
+}
+template<typename Itr, typename Comp>
+void kway_merge_inplace(const std::vector<Itr>& bounds, Comp cmp) {
+	//merges the neighbouring sorted runs [bounds[i], bounds[i + 1]) of one list, pairs of runs are merged in rounds so
+	//each item is moved O(log k) times, using a buffer of at most KWAY_MERGE_BUFFER_BYTES (rotate merges if it can't be allocated)
+	using valueof = typename stlib_internal::value_for<Itr>::value_type;
+	if(bounds.size() <= 2)
+		return;
+	uint64_t sze = distance(bounds.front(), bounds.back());
+	uint64_t bufsze = KWAY_MERGE_BUFFER_BYTES / sizeof(valueof);
+	if(bufsze > sze / 2)
+		bufsze = sze / 2;
+	valueof* buf = bufsze > 0 ? (valueof*)stlib_internal::aligned_storage_new(bufsze * sizeof(valueof)) : nullptr;
+	if(!buf)
+		bufsze = 0;
+
+	std::vector<Itr> crnt = bounds;
+	while(crnt.size() > 2) {
+		std::vector<Itr> next;
+		next.reserve(crnt.size() / 2 + 2);
+		size_t i = 0;
+		for(; i + 2 < crnt.size(); i += 2) {
+			next.push_back(crnt[i]);
+			stlib_internal::buffered_merge(crnt[i], crnt[i + 1], crnt[i + 2], buf, bufsze, cmp);
+		}
+		//an odd run out is carried to the next round
+		for(; i < crnt.size(); ++i)
+			next.push_back(crnt[i]);
+		crnt.swap(next);
+	}
+
+	if(buf)
+		stlib_internal::aligned_storage_delete(bufsze * sizeof(valueof), buf);
+}
+
+template<typename T, typename Comp = std::less<T>>
+class sort_stream {
+	using item_itr = typename std::vector<T>::iterator;
+
+	std::vector<T> items;
+	//where each sorted run starts in items
+	std::vector<size_t> run_begs;
+	Comp cmp;
+	//the rest of each run and the loser tree over them (as kway_merge), once finished
+	std::vector<std::pair<item_itr, item_itr>> heads;
+	std::vector<unsigned> tree;
+	bool finished = false;
+
+	size_t run_length(size_t run) const {
+		return (run + 1 < run_begs.size() ? run_begs[run + 1] : items.size()) - run_begs[run];
+	}
+	void collapse() {
+		//merge runs (as timsort does) until each of the last runs is more than twice the next and more than the next two
+		//together, the run lengths then grow atleast as fast as the fibonacci numbers so there are O(log n) runs left
+		while(run_begs.size() > 1) {
+			size_t count = run_begs.size();
+			size_t at = count - 2;
+			if((count > 2 && run_length(count - 3) <= run_length(count - 2) + run_length(count - 1)) ||
+			   (count > 3 && run_length(count - 4) <= run_length(count - 3) + run_length(count - 2))) {
+				//merge the middle run with the shorter of its neighbours
+				if(run_length(count - 3) < run_length(count - 1))
+					at = count - 3;
+			} else if(2 * run_length(count - 1) < run_length(count - 2))
+				break;
+			std::vector<item_itr> bounds = {items.begin() + run_begs[at], items.begin() + run_begs[at + 1], items.begin() + run_begs[at + 1] + run_length(at + 1)};
+			kway_merge_inplace(bounds, cmp);
+			run_begs.erase(run_begs.begin() + at + 1);
+		}
+	}
+	void next() {
+		//take the winner's item and replay its matches to the root, a run that runs out is taken out and the tree built again
+		unsigned win = tree[0];
+		if(++heads[win].first == heads[win].second) {
+			heads.erase(heads.begin() + win);
+			if(!heads.empty())
+				stlib_internal::kway_merge_build(heads, tree, cmp);
+		} else
+			stlib_internal::kway_merge_replay(heads, tree, win, cmp);
+	}
+	bool done() const {
+		return heads.empty();
+	}
+public:
+	class iterator {
+		sort_stream* strm = nullptr;
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = T;
+		using difference_type = ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		iterator() = default;
+		explicit iterator(sort_stream* str) : strm(str && !str->done() ? str : nullptr) {}
+		const T& operator*() const {
+			return *strm->heads[strm->tree[0]].first;
+		}
+		const T* operator->() const {
+			return &**this;
+		}
+		iterator& operator++() {
+			strm->next();
+			if(strm->done())
+				strm = nullptr;
+			return *this;
+		}
+		bool operator==(const iterator& rhs) const {
+			return strm == rhs.strm;
+		}
+		bool operator!=(const iterator& rhs) const {
+			return strm != rhs.strm;
+		}
+	};
+
+	sort_stream() = default;
+	explicit sort_stream(Comp comp) : cmp(comp) {}
+	sort_stream(const sort_stream&) = delete;
+	sort_stream& operator=(const sort_stream&) = delete;
+
+	//adds a chunk of items, it is sorted now and merged with the earlier chunks as the runs grow, so less is left for finish
+	//a chunk that carries on from the last one (already in order) just makes the last run longer
+	//returns false and adds nothing once finish has been called, as the merge is already reading from the runs
+	template<typename Itr>
+	bool push(Itr beg, Itr end) {
+		if(finished)
+			return false;
+		size_t sze = items.size();
+		items.insert(items.end(), beg, end);
+		if(items.size() == sze)
+			return true;
+		if(items.size() - sze <= INSERTION_SORT_CUTOFF)
+			multi_insertion_sort(items.begin() + sze, items.end(), cmp);
+		else if(!hybrid_merge_sort(items.begin() + sze, items.end(), cmp))
+			hybrid_stackless_rotate_merge_sort(items.begin() + sze, items.end(), cmp);
+		if(sze == 0 || stlib_internal::less_func(items[sze], items[sze - 1], cmp))
+			run_begs.push_back(sze);
+		collapse();
+		return true;
+	}
+	//no more chunks are coming (push can't be called after this), the sorted items can then be read from begin() to end(),
+	//merging the runs as they are read, equal items come out in the order they were pushed
+	void finish() {
+		if(finished)
+			return;
+		finished = true;
+		unsigned k = (unsigned)run_begs.size();
+		if(k == 0)
+			return;
+		for(unsigned i = 0; i < k; ++i)
+			heads.push_back(std::make_pair(items.begin() + run_begs[i], i + 1 < k ? items.begin() + run_begs[i + 1] : items.end()));
+		stlib_internal::kway_merge_build(heads, tree, cmp);
+	}
+
+	//the sorted items not read yet, calls finish if it hasn't been, this is a single pass so each item is read once
+	iterator begin() {
+		finish();
+		return iterator(this);
+	}
+	iterator end() {
+		return iterator();
+	}
+	//all of the items pushed
+	size_t size() const {
+		return items.size();
+	}
+	//how many sorted runs are waiting to be merged
+	size_t runs() const {
+		return run_begs.size();
+	}
+};
+
 }
 
 